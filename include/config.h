@@ -5,6 +5,14 @@
 #define CONFIG_SERIAL_DEBUG 1
 #define CONFIG_VGA_DEBUG 1
 #define CONFIG_MEMORY_DEBUG 1
+#define CONFIG_MEMORY_DEBUG_SLOTS 4096
+#define CONFIG_HEAP_NEXT_FIT 0
+#define CONFIG_KHEAP_MAX_PAGES 65536
+#define CONFIG_KHEAP_GROW_PAGES 16
+#define CONFIG_KHEAP_TRIM_PAGES 64
+#define CONFIG_TLB_FLUSH_MAX_PAGES 32
+#define CONFIG_STRING_NT_THRESHOLD 262144
+#define CONFIG_KLOG_RECORDS 256
 #define CONFIG_PAGE_SIZE 4096
 #define CONFIG_MAX_PAGES 1024
 #define CONFIG_KERNEL_HEAP_SIZE (1024
@@ -13,6 +21,7 @@
 #define CONFIG_VGA_HEIGHT 25
 #define CONFIG_TERM_COLOR 0
 #define CONFIG_TERM_BG_COLOR 0
+#define CONFIG_TERM_SCROLLBACK 500
 #define CONFIG_KEYBOARD_BUFFER 256
 #define CONFIG_CMD_HISTORY 10
 #define CONFIG_MAX_FILES 100
@@ -24,6 +33,7 @@
 #define CONFIG_NETWORK 1
 #define CONFIG_TCP_IP 1
 #define CONFIG_MAX_SOCKETS 32
+#define CONFIG_NET_PACKET_POOL 256
 #define CONFIG_SERIAL_PORT 0
 #define CONFIG_SERIAL_BAUD 115200
 #define CONFIG_TIMER_FREQ 100
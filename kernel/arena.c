@@ -0,0 +1,131 @@
+#include "include/arena.h"
+#include "include/memory.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+// Default allocation alignment
+#define ARENA_ALIGN 8
+
+// Chunk header, followed by the chunk's data
+struct ArenaChunk {
+    ArenaChunk* prev;           // Chunk that was current before this one
+    size_t size;                // Total size, header included
+    size_t used;                // Bytes handed out from the data area
+};
+
+#define CHUNK_HEADER ((sizeof(ArenaChunk) + 15) & ~(size_t)15)
+
+struct Arena {
+    ArenaChunk* current;        // Chunk allocations are bumped from
+    ArenaChunk* spare;          // Released chunk kept for the next overflow
+    size_t chunk_size;
+};
+
+static inline uintptr_t chunk_data(const ArenaChunk* chunk) {
+    return (uintptr_t)chunk + CHUNK_HEADER;
+}
+
+// Chain on a chunk with at least need bytes of data
+static ArenaChunk* chunk_push(Arena* arena, size_t need) {
+    ArenaChunk* chunk = NULL;
+
+    if (arena->spare && arena->spare->size - CHUNK_HEADER >= need) {
+        chunk = arena->spare;
+        arena->spare = NULL;
+    } else {
+        size_t size = arena->chunk_size;
+        if (size - CHUNK_HEADER < need) {
+            size = CHUNK_HEADER + need;
+        }
+        chunk = (ArenaChunk*)kmalloc(size);
+        if (!chunk) return NULL;
+        chunk->size = size;
+    }
+
+    chunk->prev = arena->current;
+    chunk->used = 0;
+    arena->current = chunk;
+    return chunk;
+}
+
+// Give a chunk back, keeping the largest one seen as the spare
+static void chunk_release(Arena* arena, ArenaChunk* chunk) {
+    if (arena->spare && arena->spare->size >= chunk->size) {
+        kfree(chunk);
+        return;
+    }
+    kfree(arena->spare);
+    arena->spare = chunk;
+}
+
+// Create an arena
+Arena* arena_create(size_t chunk_size) {
+    if (chunk_size == 0) chunk_size = ARENA_DEFAULT_CHUNK;
+    if (chunk_size <= CHUNK_HEADER) return NULL;
+
+    Arena* arena = (Arena*)kmalloc(sizeof(Arena));
+    if (!arena) return NULL;
+
+    arena->current = NULL;
+    arena->spare = NULL;
+    arena->chunk_size = chunk_size;
+    return arena;
+}
+
+// Bump-allocate from the current chunk, chaining a new one if it is full
+void* arena_alloc(Arena* arena, size_t size, size_t align) {
+    if (align == 0) align = ARENA_ALIGN;
+    if (align & (align - 1)) return NULL;
+    if (size > SIZE_MAX / 2 || align > SIZE_MAX / 4) return NULL;
+
+    ArenaChunk* chunk = arena->current;
+    if (chunk) {
+        // Compare against the space left rather than adding to the
+        // address, which can wrap for chunks high in the heap
+        uintptr_t next = chunk_data(chunk) + chunk->used;
+        uintptr_t end = (uintptr_t)chunk + chunk->size;
+        uintptr_t pad = -next & (uintptr_t)(align - 1);
+        if (pad <= end - next && size <= end - next - pad) {
+            uintptr_t start = next + pad;
+            chunk->used = start + size - chunk_data(chunk);
+            return (void*)start;
+        }
+    }
+
+    chunk = chunk_push(arena, size + align - 1);
+    if (!chunk) return NULL;
+
+    uintptr_t start = (chunk_data(chunk) + align - 1) & ~(uintptr_t)(align - 1);
+    chunk->used = start + size - chunk_data(chunk);
+    return (void*)start;
+}
+
+// Remember the current position
+ArenaMark arena_mark(const Arena* arena) {
+    ArenaMark mark;
+    mark.chunk = arena->current;
+    mark.used = arena->current ? arena->current->used : 0;
+    return mark;
+}
+
+// Roll the arena back to a mark
+void arena_reset(Arena* arena, ArenaMark mark) {
+    while (arena->current != mark.chunk) {
+        ArenaChunk* chunk = arena->current;
+        arena->current = chunk->prev;
+        chunk_release(arena, chunk);
+    }
+    if (arena->current) {
+        arena->current->used = mark.used;
+    }
+}
+
+// Free an arena and everything in it
+void arena_destroy(Arena* arena) {
+    if (!arena) return;
+
+    ArenaMark empty = { NULL, 0 };
+    arena_reset(arena, empty);
+    kfree(arena->spare);
+    kfree(arena);
+}
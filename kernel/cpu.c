@@ -2,6 +2,8 @@
 #include <stdbool.h>
 #include "include/cpu.h"
 #include "include/asm.h"
+#include "include/fpu.h"
+#include "../include/config.h"
 
 // CPU information
 static cpu_info_t cpu_info;
@@ -9,6 +11,7 @@ static cpu_info_t cpu_info;
 // CPU features
 static uint32_t cpu_features_edx = 0;
 static uint32_t cpu_features_ecx = 0;
+static uint32_t cpu_features_ext_ebx = 0;
 
 void cpu_init(void) {
     uint32_t eax, ebx, ecx, edx;
@@ -19,6 +22,13 @@ void cpu_init(void) {
     
     cpuid(CPUID_FEATURES_ECX, &eax, &ebx, &ecx, &edx);
     cpu_features_ecx = ecx;
+
+    // Structured extended features, if leaf 7 exists
+    cpuid(0, &eax, &ebx, &ecx, &edx);
+    if (eax >= 7) {
+        cpuid_count(7, 0, &eax, &ebx, &ecx, &edx);
+        cpu_features_ext_ebx = ebx;
+    }
     
     // Get CPU information
     cpu_get_info(&cpu_info);
@@ -71,27 +81,33 @@ bool cpu_has_feature(uint32_t feature) {
     return (cpu_features_edx & feature) != 0;
 }
 
+// Check for a structured extended feature
+bool cpu_has_extended_feature(uint32_t feature) {
+    return (cpu_features_ext_ebx & feature) != 0;
+}
+
 // Enable CPU features
 void cpu_enable_features(void) {
     uint32_t cr4 = READ_CR4();
     
-    // Enable PAE if supported
-    if (cpu_has_feature(CPUID_FEATURE_PAE)) {
-        cr4 |= CPUID_FEATURE_PAE;
-    }
+    // The VMM builds classic two-level tables, so PAE must stay off
+    cr4 &= ~CR4_PAE;
     
-    // Enable PSE if supported
+    // Enable PSE if supported (4 MB pages)
     if (cpu_has_feature(CPUID_FEATURE_PSE)) {
-        cr4 |= CPUID_FEATURE_PSE;
+        cr4 |= CR4_PSE;
     }
     
     // Enable PGE if supported
     if (cpu_has_feature(CPUID_FEATURE_PGE)) {
-        cr4 |= CPUID_FEATURE_PGE;
+        cr4 |= CR4_PGE;
     }
     
     // Write back control registers
     WRITE_CR4(cr4);
+
+    // x87 and SSE state
+    fpu_init();
 }
 
 // Enable interrupts
@@ -110,9 +126,9 @@ void halt_cpu(void) {
 }
 
 // Enable paging
-void enable_paging(uint64_t* page_dir) {
+void enable_paging(uint32_t* page_dir) {
     // Load the page directory
-    load_page_directory((uint32_t*)page_dir);
+    load_page_directory(page_dir);
     
     // Enable paging
     uint32_t cr0 = READ_CR0();
@@ -137,6 +153,29 @@ void load_page_directory(uint32_t* page_directory) {
 
 // Flush TLB
 void flush_tlb(void) {
-    uint32_t cr3 = READ_CR3();
-    WRITE_CR3(cr3);
+    uint32_t cr4 = READ_CR4();
+    if (cr4 & CR4_PGE) {
+        // A CR3 reload keeps global entries; toggling PGE drops them too
+        WRITE_CR4(cr4 & ~CR4_PGE);
+        WRITE_CR4(cr4);
+    } else {
+        uint32_t cr3 = READ_CR3();
+        WRITE_CR3(cr3);
+    }
+}
+
+// Flush a single page from the TLB
+void tlb_flush_page(uintptr_t virt) {
+    INVLPG(virt);
+}
+
+// Flush a run of pages from the TLB
+void tlb_flush_range(uintptr_t virt, size_t pages) {
+    if (pages > CONFIG_TLB_FLUSH_MAX_PAGES) {
+        flush_tlb();
+        return;
+    }
+    for (size_t i = 0; i < pages; i++) {
+        INVLPG(virt + i * 4096);
+    }
 } 
\ No newline at end of file
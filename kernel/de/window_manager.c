@@ -55,7 +55,7 @@ int wm_create_window(const char* title, int x, int y, int width, int height) {
     if (!win->buffer) return -1;
     
     // Clear window buffer
-    memset(win->buffer, COLOR_WINDOW_BG, width * height * sizeof(uint32_t));
+    memset32(win->buffer, COLOR_WINDOW_BG, width * height);
     
     // Draw window
     wm_draw_window(window_count);
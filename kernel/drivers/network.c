@@ -2,20 +2,39 @@
 #include <stdbool.h>
 #include <string.h>
 #include "../include/terminal.h"
+#include "../../include/config.h"
 #include "network.h"
 
 // Maximum number of network devices
 #define MAX_NETWORK_DEVICES 4
 
+// Packet pool size; indices must fit the 16-bit free-stack links
+#define PACKET_POOL_SIZE CONFIG_NET_PACKET_POOL
+#define PACKET_NONE 0xFFFF
+
 // Network device list
 static NetworkDevice devices[MAX_NETWORK_DEVICES];
 static int device_count = 0;
 
+// Preallocated packet buffers. The free stack head packs a 16-bit ABA tag
+// above the 16-bit index of the top buffer, so push and pop are a single
+// 32-bit compare-and-swap.
+static NetworkPacket packet_pool[PACKET_POOL_SIZE];
+static volatile uint32_t free_head = PACKET_NONE;
+static volatile uint32_t free_count = 0;
+static volatile uint32_t low_water = 0;
+static volatile uint32_t alloc_count = 0;
+static volatile uint32_t exhausted_count = 0;
+
+_Static_assert(PACKET_POOL_SIZE < PACKET_NONE, "packet pool too large for 16-bit links");
+
 // Initialize network subsystem
 bool network_init(void) {
     // Clear device list
     memset(devices, 0, sizeof(devices));
     device_count = 0;
+
+    packet_pool_init();
     
     // TODO: Initialize network hardware
     // This would typically involve:
@@ -111,4 +130,70 @@ void network_handle_interrupt(NetworkDevice* device) {
     // 2. Handling received packets
     // 3. Handling transmission completion
     // 4. Handling errors
-} 
\ No newline at end of file
+}
+
+// Link every buffer onto the free stack
+void packet_pool_init(void) {
+    for (uint32_t i = 0; i < PACKET_POOL_SIZE; i++) {
+        packet_pool[i].next_free = (i + 1 < PACKET_POOL_SIZE) ? i + 1 : PACKET_NONE;
+    }
+    free_head = 0;
+    free_count = PACKET_POOL_SIZE;
+    low_water = PACKET_POOL_SIZE;
+    alloc_count = 0;
+    exhausted_count = 0;
+}
+
+// Pop a buffer off the free stack
+NetworkPacket* packet_alloc(void) {
+    uint32_t head = __atomic_load_n(&free_head, __ATOMIC_ACQUIRE);
+    uint32_t next;
+    do {
+        uint32_t index = head & 0xFFFF;
+        if (index == PACKET_NONE) {
+            __atomic_fetch_add(&exhausted_count, 1, __ATOMIC_RELAXED);
+            return NULL;
+        }
+        next = ((head + 0x10000) & 0xFFFF0000) | packet_pool[index].next_free;
+    } while (!__atomic_compare_exchange_n(&free_head, &head, next, true,
+                                          __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+
+    NetworkPacket* packet = &packet_pool[head & 0xFFFF];
+    packet->data = packet->buffer + PACKET_HEADROOM;
+    packet->length = 0;
+
+    // Track the lowest number of free buffers seen
+    uint32_t free_now = __atomic_sub_fetch(&free_count, 1, __ATOMIC_RELAXED);
+    uint32_t low = __atomic_load_n(&low_water, __ATOMIC_RELAXED);
+    while (free_now < low &&
+           !__atomic_compare_exchange_n(&low_water, &low, free_now, true,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+    __atomic_fetch_add(&alloc_count, 1, __ATOMIC_RELAXED);
+    return packet;
+}
+
+// Push a buffer back onto the free stack
+void packet_free(NetworkPacket* packet) {
+    if (packet < packet_pool || packet >= packet_pool + PACKET_POOL_SIZE) return;
+
+    uint32_t index = packet - packet_pool;
+    uint32_t head = __atomic_load_n(&free_head, __ATOMIC_RELAXED);
+    uint32_t next;
+    do {
+        packet->next_free = head & 0xFFFF;
+        next = ((head + 0x10000) & 0xFFFF0000) | index;
+    } while (!__atomic_compare_exchange_n(&free_head, &head, next, true,
+                                          __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+
+    __atomic_fetch_add(&free_count, 1, __ATOMIC_RELAXED);
+}
+
+// Snapshot the pool counters
+void packet_pool_stats(PacketPoolStats* stats) {
+    stats->size = PACKET_POOL_SIZE;
+    stats->free = free_count;
+    stats->low_water = low_water;
+    stats->allocs = alloc_count;
+    stats->exhausted = exhausted_count;
+}
@@ -2,6 +2,7 @@
 #define NETWORK_H
 
 #include <stdint.h>
+#include <stddef.h>
 #include <stdbool.h>
 
 // Ethernet frame structure
@@ -13,11 +14,78 @@ typedef struct {
     uint16_t payload_length;
 } EthernetFrame;
 
+// Packet buffer layout. Every buffer starts on its own cache line and
+// leaves room in front of the frame for headers to be prepended and
+// behind it for trailers. The 2 bytes on top of the 64-byte headroom
+// put the IP header on a 4-byte boundary after the Ethernet header.
+#define PACKET_ALIGN       64
+#define PACKET_MAX_FRAME   1518
+#define PACKET_HEADROOM    66
+#define PACKET_BUFFER_SIZE 1664
+#define PACKET_TAILROOM    (PACKET_BUFFER_SIZE - PACKET_HEADROOM - PACKET_MAX_FRAME)
+
 // Network packet structure
 typedef struct {
-    uint8_t data[1518];  // Maximum Ethernet frame size
+    uint8_t* data;       // Start of the frame inside buffer
     uint16_t length;     // Actual packet length
-} NetworkPacket;
+    uint16_t next_free;  // Pool free-stack link
+    uint8_t buffer[PACKET_BUFFER_SIZE] __attribute__((aligned(PACKET_ALIGN)));
+} __attribute__((aligned(PACKET_ALIGN))) NetworkPacket;
+
+// Packet pool statistics
+typedef struct {
+    uint32_t size;       // Buffers in the pool
+    uint32_t free;       // Buffers free right now
+    uint32_t low_water;  // Fewest buffers ever free
+    uint32_t allocs;     // Successful packet_alloc calls
+    uint32_t exhausted;  // packet_alloc calls that found the pool empty
+} PacketPoolStats;
+
+// Set up the preallocated packet pool
+void packet_pool_init(void);
+
+// Take a buffer from the pool with the frame empty and positioned after
+// the headroom. Safe from interrupt context; returns NULL when empty.
+NetworkPacket* packet_alloc(void);
+
+// Return a buffer to the pool
+void packet_free(NetworkPacket* packet);
+
+// Pool counters
+void packet_pool_stats(PacketPoolStats* stats);
+
+// Bytes free in front of and behind the frame
+static inline size_t packet_headroom(const NetworkPacket* packet) {
+    return packet->data - packet->buffer;
+}
+
+static inline size_t packet_tailroom(const NetworkPacket* packet) {
+    return packet->buffer + PACKET_BUFFER_SIZE - (packet->data + packet->length);
+}
+
+// Prepend len bytes of header and return the new frame start
+static inline uint8_t* packet_push(NetworkPacket* packet, size_t len) {
+    if (packet_headroom(packet) < len) return NULL;
+    packet->data -= len;
+    packet->length += len;
+    return packet->data;
+}
+
+// Strip len bytes from the front of the frame and return the new start
+static inline uint8_t* packet_pull(NetworkPacket* packet, size_t len) {
+    if (packet->length < len) return NULL;
+    packet->data += len;
+    packet->length -= len;
+    return packet->data;
+}
+
+// Append len bytes to the frame and return where they go
+static inline uint8_t* packet_put(NetworkPacket* packet, size_t len) {
+    if (packet_tailroom(packet) < len) return NULL;
+    uint8_t* tail = packet->data + packet->length;
+    packet->length += len;
+    return tail;
+}
 
 // Network device structure
 typedef struct {
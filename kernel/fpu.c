@@ -0,0 +1,137 @@
+#include "include/fpu.h"
+#include "include/cpu.h"
+#include "include/asm.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+// MXCSR at reset: all SIMD exceptions masked, round to nearest
+#define MXCSR_DEFAULT 0x1F80
+
+static bool fpu_present = false;
+static bool fxsr = false;
+static bool sse = false;
+
+// The context that is running, and the one whose state is in the
+// registers right now. They differ after a switch until the new context
+// touches the FPU; NULL owner means the registers hold nothing worth
+// keeping.
+static FpuContext boot_context;
+static FpuContext* fpu_current = &boot_context;
+static FpuContext* fpu_owner = NULL;
+
+static bool kernel_section = false;
+
+// Write the register state to a context
+static void fpu_save(FpuContext* context) {
+    if (fxsr) {
+        __asm__ __volatile__("fxsave %0" : "=m" (context->state));
+    } else {
+        __asm__ __volatile__("fnsave %0; fwait" : "=m" (context->state));
+    }
+}
+
+// Load the register state from a context
+static void fpu_restore(const FpuContext* context) {
+    if (fxsr) {
+        __asm__ __volatile__("fxrstor %0" : : "m" (context->state));
+    } else {
+        __asm__ __volatile__("frstor %0" : : "m" (context->state));
+    }
+}
+
+// Put the registers in their power-on state
+static void fpu_reset(void) {
+    uint32_t mxcsr = MXCSR_DEFAULT;
+    __asm__ __volatile__("fninit");
+    if (sse) {
+        __asm__ __volatile__("ldmxcsr %0" : : "m" (mxcsr));
+    }
+}
+
+// Turn on the FPU and SSE
+void fpu_init(void) {
+    if (!cpu_has_feature(CPU_FEATURE_FPU)) return;
+
+    // Native FPU error reporting, and WAIT honours TS
+    uint32_t cr0 = READ_CR0();
+    cr0 &= ~(CR0_EM | CR0_TS);
+    cr0 |= CR0_MP | CR0_NE;
+    WRITE_CR0(cr0);
+
+    fxsr = cpu_has_feature(CPU_FEATURE_FXSR);
+    if (fxsr && cpu_has_feature(CPU_FEATURE_SSE)) {
+        WRITE_CR4(READ_CR4() | CR4_OSFXSR | CR4_OSXMMEXCPT);
+        sse = true;
+    }
+
+    fpu_present = true;
+    fpu_reset();
+    boot_context.used = true;
+    fpu_owner = &boot_context;
+}
+
+// Check whether SSE is enabled
+bool fpu_sse_enabled(void) {
+    return sse;
+}
+
+// Prepare a context that has never used the FPU
+void fpu_context_init(FpuContext* context) {
+    context->used = false;
+}
+
+// Switch contexts; the register state follows on first use
+void fpu_switch(FpuContext* context) {
+    fpu_current = context;
+    if (fpu_present && fpu_owner != context) {
+        WRITE_CR0(READ_CR0() | CR0_TS);
+    }
+}
+
+// Hand the FPU to the running context
+bool fpu_handle_nm(void) {
+    if (!fpu_present) return false;
+
+    CLTS();
+    if (fpu_owner == fpu_current) return true;
+
+    if (fpu_owner) {
+        fpu_save(fpu_owner);
+    }
+    if (fpu_current->used) {
+        fpu_restore(fpu_current);
+    } else {
+        fpu_reset();
+        fpu_current->used = true;
+    }
+    fpu_owner = fpu_current;
+    return true;
+}
+
+// Check whether a kernel SIMD section may be opened
+bool kernel_fpu_usable(void) {
+    return fpu_present && !kernel_section;
+}
+
+// Open a kernel SIMD section, saving whatever state is live
+void kernel_fpu_begin(void) {
+    uint32_t eflags = READ_EFLAGS();
+    CLI();
+
+    kernel_section = true;
+    CLTS();
+    if (fpu_owner) {
+        fpu_save(fpu_owner);
+        fpu_owner = NULL;
+    }
+    fpu_reset();
+
+    WRITE_EFLAGS(eflags);
+}
+
+// Close a kernel SIMD section. The running context gets its state back
+// when it next touches the FPU.
+void kernel_fpu_end(void) {
+    WRITE_CR0(READ_CR0() | CR0_TS);
+    kernel_section = false;
+}
@@ -1,5 +1,8 @@
 #include "include/graphics.h"
 #include "include/io.h"
+#include "include/vmm.h"
+#include "include/pat.h"
+#include "include/asm.h"
 #include <string.h>
 #include <stdlib.h>  // For abs()
 
@@ -32,6 +35,9 @@ static uint16_t screen_height = 0;
 static uint8_t screen_bpp = 0;
 static uint16_t screen_pitch = 0;
 
+// Variable MTRR covering the framebuffer when PAT is unavailable
+static int lfb_mtrr = -1;
+
 // Internal functions
 static int abs(int x) {
     return (x < 0) ? -x : x;
@@ -78,7 +84,32 @@ void graphics_set_mode(uint16_t width, uint16_t height, uint8_t bpp) {
     screen_height = height;
     screen_bpp = bpp;
     screen_pitch = width * (bpp / 8);
-    framebuffer = (uint32_t*)0xFD000000; // LFB address
+    framebuffer = (uint32_t*)GRAPHICS_LFB_ADDRESS;
+}
+
+// Leave VBE mode and return to VGA text mode
+void graphics_disable(void) {
+    vbe_write(VBE_DISPI_INDEX_ENABLE, VBE_DISPI_DISABLED);
+}
+
+// Switch the framebuffer mapping between write-combining and the default
+// caching. Uses the PAT when available and a variable MTRR otherwise.
+bool graphics_set_write_combining(bool enable) {
+    if (pat_enabled()) {
+        uint32_t cache = enable ? pat_write_combining_flags() : 0;
+        return vmm_set_cache(GRAPHICS_LFB_ADDRESS, GRAPHICS_LFB_SIZE, cache);
+    }
+
+    if (enable) {
+        if (lfb_mtrr < 0) {
+            lfb_mtrr = mtrr_add(GRAPHICS_LFB_ADDRESS, GRAPHICS_LFB_SIZE, MEMTYPE_WC);
+        }
+        return lfb_mtrr >= 0;
+    }
+
+    mtrr_remove(lfb_mtrr);
+    lfb_mtrr = -1;
+    return true;
 }
 
 // Draw a pixel
@@ -120,10 +151,13 @@ void graphics_draw_rect(uint16_t x, uint16_t y, uint16_t width, uint16_t height,
 
 // Fill a rectangle
 void graphics_fill_rect(uint16_t x, uint16_t y, uint16_t width, uint16_t height, uint32_t color) {
-    for (uint16_t i = y; i < y + height; i++) {
-        for (uint16_t j = x; j < x + width; j++) {
-            graphics_put_pixel(j, i, color);
-        }
+    if (x >= screen_width || y >= screen_height) return;
+
+    uint16_t fill_width = (x + width > screen_width) ? screen_width - x : width;
+    uint16_t fill_height = (y + height > screen_height) ? screen_height - y : height;
+
+    for (uint16_t row = 0; row < fill_height; row++) {
+        memset32(&framebuffer[(y + row) * screen_width + x], color, fill_width);
     }
 }
 
@@ -174,9 +208,38 @@ void graphics_fill_circle(uint16_t x, uint16_t y, uint16_t radius, uint32_t colo
 
 // Clear screen
 void graphics_clear(uint32_t color) {
-    for (uint32_t i = 0; i < screen_width * screen_height; i++) {
-        framebuffer[i] = color;
+    memset32(framebuffer, color, (size_t)screen_width * screen_height);
+}
+
+// Copy a block of pixels to the screen, one row at a time
+void graphics_blit(uint16_t x, uint16_t y, uint16_t width, uint16_t height, const uint32_t* src) {
+    if (x >= screen_width || y >= screen_height) return;
+
+    uint16_t copy_width = (x + width > screen_width) ? screen_width - x : width;
+    uint16_t copy_height = (y + height > screen_height) ? screen_height - y : height;
+
+    for (uint16_t row = 0; row < copy_height; row++) {
+        memcpy(&framebuffer[(y + row) * screen_width + x], &src[row * width],
+               copy_width * sizeof(uint32_t));
+    }
+}
+
+// Time count full-screen clears, in TSC cycles
+uint64_t graphics_bench_clear(unsigned int count) {
+    uint64_t begin = rdtsc();
+    for (unsigned int i = 0; i < count; i++) {
+        graphics_clear(i & 1 ? COLOR_BLUE : COLOR_BLACK);
+    }
+    return rdtsc() - begin;
+}
+
+// Time count full-screen blits from src, in TSC cycles
+uint64_t graphics_bench_blit(const uint32_t* src, unsigned int count) {
+    uint64_t begin = rdtsc();
+    for (unsigned int i = 0; i < count; i++) {
+        graphics_blit(0, 0, screen_width, screen_height, src);
     }
+    return rdtsc() - begin;
 }
 
 // Double buffering (if supported)
@@ -26,6 +26,8 @@ extern void isr14(void);
 extern void isr15(void);
 extern void timer_irq_handler(void);
 extern void keyboard_irq_handler(void);
+extern void serial_irq3_handler(void);
+extern void serial_irq4_handler(void);
 
 // Set an IDT gate
 void idt_set_gate(uint8_t num, uint32_t base, uint16_t sel, uint8_t flags) {
@@ -68,6 +70,8 @@ void init_idt(void) {
     // Set up hardware interrupts (IRQs)
     idt_set_gate(32, (uint32_t)timer_irq_handler, 0x08, 0x8E);  // Timer (IRQ0)
     idt_set_gate(33, (uint32_t)keyboard_irq_handler, 0x08, 0x8E); // Keyboard (IRQ1)
+    idt_set_gate(35, (uint32_t)serial_irq3_handler, 0x08, 0x8E);  // COM2/COM4 (IRQ3)
+    idt_set_gate(36, (uint32_t)serial_irq4_handler, 0x08, 0x8E);  // COM1/COM3 (IRQ4)
 
     // Load IDT
     load_idt(&idtp);
@@ -0,0 +1,39 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+// Region allocator for short-lived scratch memory. Allocations are a
+// pointer bump in the current chunk and are never freed one by one;
+// arena_reset drops everything allocated since a mark at once.
+typedef struct Arena Arena;
+typedef struct ArenaChunk ArenaChunk;
+
+// Position in an arena to reset back to
+typedef struct {
+    ArenaChunk* chunk;
+    size_t used;
+} ArenaMark;
+
+// Default chunk size, including the chunk header
+#define ARENA_DEFAULT_CHUNK 16384
+
+// Create an arena whose chunks are chunk_size bytes (0 for the default)
+Arena* arena_create(size_t chunk_size);
+
+// Allocate size bytes aligned to align (a power of two, 0 for 8). A new
+// chunk is chained on when the current one is full. Returns NULL only
+// when the heap is out of memory.
+void* arena_alloc(Arena* arena, size_t size, size_t align);
+
+// Remember the current position
+ArenaMark arena_mark(const Arena* arena);
+
+// Release everything allocated since mark. Chunks chained on after it go
+// back to the heap, except one that is kept for reuse.
+void arena_reset(Arena* arena, ArenaMark mark);
+
+// Release the arena and all of its chunks
+void arena_destroy(Arena* arena);
+
+#endif // ARENA_H
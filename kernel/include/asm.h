@@ -47,6 +47,19 @@
 #define WRITE_CR4(x) \
     __asm__ __volatile__("movl %0, %%cr4" : : "r" (x))
 
+// CR0 bits
+#define CR0_MP (1 << 1)
+#define CR0_EM (1 << 2)
+#define CR0_TS (1 << 3)
+#define CR0_NE (1 << 5)
+
+// CR4 bits
+#define CR4_PSE (1 << 4)
+#define CR4_PAE (1 << 5)
+#define CR4_PGE (1 << 7)
+#define CR4_OSFXSR (1 << 9)
+#define CR4_OSXMMEXCPT (1 << 10)
+
 // CPU Flags
 #define READ_EFLAGS() ({ \
     uint32_t x; \
@@ -70,6 +83,34 @@
 #define NOP() \
     __asm__ __volatile__("nop")
 
+#define CLTS() \
+    __asm__ __volatile__("clts")
+
+#define INVLPG(addr) \
+    __asm__ __volatile__("invlpg (%0)" : : "r" (addr) : "memory")
+
+#define WBINVD() \
+    __asm__ __volatile__("wbinvd" ::: "memory")
+
+// Model-specific registers
+static inline uint64_t rdmsr(uint32_t msr) {
+    uint32_t lo, hi;
+    __asm__ __volatile__("rdmsr" : "=a" (lo), "=d" (hi) : "c" (msr));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+static inline void wrmsr(uint32_t msr, uint64_t value) {
+    __asm__ __volatile__("wrmsr"
+        : : "c" (msr), "a" ((uint32_t)value), "d" ((uint32_t)(value >> 32)));
+}
+
+// Time-stamp counter
+static inline uint64_t rdtsc(void) {
+    uint32_t lo, hi;
+    __asm__ __volatile__("rdtsc" : "=a" (lo), "=d" (hi));
+    return ((uint64_t)hi << 32) | lo;
+}
+
 // CPU Features
 #define CPUID_FEATURES_EDX 0x00000001
 #define CPUID_FEATURES_ECX 0x00000001
@@ -85,4 +126,11 @@ static inline void cpuid(uint32_t leaf, uint32_t* eax, uint32_t* ebx, uint32_t*
         : "a" (leaf));
 }
 
+// CPUID for leaves that take a subleaf in ECX
+static inline void cpuid_count(uint32_t leaf, uint32_t subleaf, uint32_t* eax, uint32_t* ebx, uint32_t* ecx, uint32_t* edx) {
+    __asm__ __volatile__("cpuid"
+        : "=a" (*eax), "=b" (*ebx), "=c" (*ecx), "=d" (*edx)
+        : "a" (leaf), "c" (subleaf));
+}
+
 #endif // ASM_H 
\ No newline at end of file
@@ -2,6 +2,7 @@
 #define CPU_H
 
 #include <stdint.h>
+#include <stddef.h>
 #include <stdbool.h>
 
 // CPU information structure
@@ -46,6 +47,9 @@ typedef struct {
 #define CPU_FEATURE_IA64    (1 << 30)
 #define CPU_FEATURE_PBE     (1 << 31)
 
+// Structured extended features (CPUID leaf 7, EBX)
+#define CPU_FEATURE_EXT_ERMS (1 << 9)   // Enhanced REP MOVSB/STOSB
+
 // CPU initialization
 void cpu_init(void);
 
@@ -58,6 +62,9 @@ uint32_t cpu_get_features(void);
 // Check if CPU has specific feature
 bool cpu_has_feature(uint32_t feature);
 
+// Check for a structured extended feature (CPU_FEATURE_EXT_*)
+bool cpu_has_extended_feature(uint32_t feature);
+
 // Enable CPU features
 void cpu_enable_features(void);
 
@@ -71,7 +78,7 @@ void disable_interrupts(void);
 void halt_cpu(void);
 
 // Enable paging
-void enable_paging(uint64_t* page_dir);
+void enable_paging(uint32_t* page_dir);
 
 // Disable paging
 void disable_paging(void);
@@ -79,7 +86,14 @@ void disable_paging(void);
 // Load page directory
 void load_page_directory(uint32_t* page_directory);
 
-// Flush TLB
+// Flush the whole TLB, global entries included
 void flush_tlb(void);
 
+// Invalidate the TLB entry for a single page
+void tlb_flush_page(uintptr_t virt);
+
+// Invalidate a run of pages, falling back to a full flush when the run
+// is longer than CONFIG_TLB_FLUSH_MAX_PAGES
+void tlb_flush_range(uintptr_t virt, size_t pages);
+
 #endif // CPU_H 
\ No newline at end of file
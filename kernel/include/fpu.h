@@ -0,0 +1,41 @@
+#ifndef FPU_H
+#define FPU_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Saved x87/SSE register state of one context. The area is written by
+// FXSAVE (or FNSAVE on CPUs without FXSR) and must be 16-byte aligned.
+typedef struct {
+    uint8_t state[512];
+    bool used;                  // State has been loaded at least once
+} __attribute__((aligned(16))) FpuContext;
+
+// Turn on the FPU and, where available, SSE. Called from
+// cpu_enable_features.
+void fpu_init(void);
+
+// Whether SSE instructions may be used (CR4.OSFXSR set)
+bool fpu_sse_enabled(void);
+
+// Prepare a context that has never used the FPU
+void fpu_context_init(FpuContext* context);
+
+// Make context the one that owns the FPU from now on. Its state is
+// only loaded, and the previous owner's saved, when it first touches
+// the FPU (#NM).
+void fpu_switch(FpuContext* context);
+
+// Device-not-available (#NM, vector 7) handler. Returns false if there
+// is no FPU to hand over.
+bool fpu_handle_nm(void);
+
+// Kernel SIMD sections. Code between kernel_fpu_begin and
+// kernel_fpu_end may use x87, MMX and SSE registers freely. Sections do
+// not nest; check kernel_fpu_usable first where one may already be
+// open, e.g. in interrupt handlers.
+bool kernel_fpu_usable(void);
+void kernel_fpu_begin(void);
+void kernel_fpu_end(void);
+
+#endif // FPU_H
@@ -14,6 +14,10 @@
 #define COLOR_CYAN      0xFF00FFFF
 #define COLOR_MAGENTA   0xFFFF00FF
 
+// Bochs/QEMU VBE linear framebuffer
+#define GRAPHICS_LFB_ADDRESS 0xFD000000
+#define GRAPHICS_LFB_SIZE    (16 * 1024 * 1024)
+
 // VBE mode info structure
 struct vbe_mode_info {
     uint16_t attributes;
@@ -61,6 +65,7 @@ void graphics_fill_rect(uint16_t x, uint16_t y, uint16_t width, uint16_t height,
 void graphics_draw_circle(uint16_t x, uint16_t y, uint16_t radius, uint32_t color);
 void graphics_fill_circle(uint16_t x, uint16_t y, uint16_t radius, uint32_t color);
 void graphics_clear(uint32_t color);
+void graphics_blit(uint16_t x, uint16_t y, uint16_t width, uint16_t height, const uint32_t* src);
 void graphics_swap_buffers(void);
 
 // Font rendering
@@ -73,4 +78,14 @@ uint16_t graphics_get_height(void);
 uint8_t graphics_get_bpp(void);
 uint32_t* graphics_get_framebuffer(void);
 
+// Return to VGA text mode
+void graphics_disable(void);
+
+// Framebuffer caching: write-combining or the default
+bool graphics_set_write_combining(bool enable);
+
+// Benchmarks, in TSC cycles
+uint64_t graphics_bench_clear(unsigned int count);
+uint64_t graphics_bench_blit(const uint32_t* src, unsigned int count);
+
 #endif // GRAPHICS_H 
\ No newline at end of file
@@ -54,5 +54,7 @@ extern void isr14(void);
 extern void isr15(void);
 extern void timer_irq_handler(void);
 extern void keyboard_irq_handler(void);
+extern void serial_irq3_handler(void);
+extern void serial_irq4_handler(void);
 
 #endif /* _INTERRUPT_H */ 
\ No newline at end of file
@@ -43,7 +43,6 @@ void kernel_main(uint32_t magic, MultibootInfo* info);
 void kernel_init(void);
 void* kmalloc(size_t size);
 void kfree(void* ptr);
-bool init_paging(void);
 
 // External symbols
 extern uint64_t start;
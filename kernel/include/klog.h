@@ -0,0 +1,45 @@
+#ifndef KLOG_H
+#define KLOG_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdarg.h>
+
+// Kernel log. Messages are formatted on the caller's stack and copied
+// into a fixed ring of records; nothing touches the screen until
+// klog_flush runs from the main loop. Writers never block or take a
+// lock, so klog is safe to call from interrupt handlers.
+typedef enum {
+    KLOG_ERR = 0,
+    KLOG_WARN = 1,
+    KLOG_INFO = 2,
+    KLOG_DEBUG = 3
+} KlogLevel;
+
+// Longest message text kept in a record; longer messages are cut
+#define KLOG_TEXT_MAX 112
+
+// One log record as read back out of the ring
+typedef struct {
+    uint32_t seq;               // Position in the log, counting from 0
+    uint64_t timestamp;         // TSC when the record was written
+    KlogLevel level;
+    size_t length;
+    char text[KLOG_TEXT_MAX];   // Not NUL-terminated
+} KlogEntry;
+
+// Append a message at the given level
+void klog(KlogLevel level, const char* format, ...) __attribute__((format(printf, 2, 3)));
+void vklog(KlogLevel level, const char* format, va_list args);
+
+// Print records not yet shown on the console, skipping those above the
+// console level. Call only from the main loop, never from an ISR.
+void klog_flush(void);
+
+// Most verbose level klog_flush prints (KLOG_INFO by default)
+void klog_set_console_level(KlogLevel level);
+
+// Print every record still in the ring (the dmesg command)
+void klog_dump(void);
+
+#endif // KLOG_H
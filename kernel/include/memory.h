@@ -2,6 +2,8 @@
 #define MEMORY_H
 
 #include <stddef.h>
+#include <stdint.h>
+#include "../../include/config.h"
 
 // Memory initialization
 void memory_init(void);
@@ -10,8 +12,98 @@ void memory_init(void);
 void* kmalloc(size_t size);
 void kfree(void* ptr);
 
+// Zeroed array allocation; fails if count * size overflows
+void* kcalloc(size_t count, size_t size);
+
+// Resize an allocation, in place when the size class or the following
+// free pages allow it. krealloc(NULL, n) allocates, krealloc(p, 0) frees.
+void* krealloc(void* ptr, size_t size);
+
+// Bytes usable behind an allocation
+size_t ksize(const void* ptr);
+
+// Bytes currently mapped into the kernel heap
+size_t kheap_size(void);
+
+// Slab caches for fixed-size kernel objects
+typedef struct kmem_cache kmem_cache_t;
+
+kmem_cache_t* kmem_cache_create(const char* name, size_t size, size_t align);
+void kmem_cache_destroy(kmem_cache_t* cache);
+void* kmem_cache_alloc(kmem_cache_t* cache);
+void kmem_cache_free(kmem_cache_t* cache, void* obj);
+
 // Memory constants
 #define PAGE_SIZE 4096
 #define MAX_PAGES 1024
 
-#endif // MEMORY_H 
\ No newline at end of file
+// kmalloc size classes: powers of two from 16 bytes to 2 KB.
+// Anything larger is served in whole pages.
+#define KMALLOC_MIN_SHIFT 4
+#define KMALLOC_MAX_SHIFT 11
+#define KMALLOC_MAX_SIZE (1 << KMALLOC_MAX_SHIFT)
+#define KMALLOC_CLASSES (KMALLOC_MAX_SHIFT - KMALLOC_MIN_SHIFT + 1)
+
+// Free runs are bucketed by power-of-two length; the last bucket is open
+#define KHEAP_HISTOGRAM_BUCKETS 11
+
+// Counters for one allocation class
+typedef struct {
+    const char* name;
+    size_t object_size;     // 0 for allocations served in whole pages
+    size_t allocs;
+    size_t frees;
+    size_t failures;
+    size_t live_bytes;
+    size_t peak_bytes;
+} KmallocStats;
+
+// Heap snapshot returned by kheap_get_stats
+typedef struct {
+    KmallocStats classes[KMALLOC_CLASSES + 1];  // Last entry: above KMALLOC_MAX_SIZE
+    size_t heap_pages;          // Virtual pages owned by the heap
+    size_t mapped_pages;        // Pages with a frame behind them
+    size_t free_pages;          // Pages in free runs
+    size_t free_mapped_pages;   // Free pages still holding a frame
+    size_t free_runs;
+    size_t largest_free_run;
+    size_t free_histogram[KHEAP_HISTOGRAM_BUCKETS];
+    unsigned int fragmentation; // Percent of free pages outside the largest run
+} KheapStats;
+
+// Fill in allocation counters and a free-space summary
+void kheap_get_stats(KheapStats* stats);
+
+#if CONFIG_MEMORY_DEBUG
+// Live kmalloc allocations made from one call site
+typedef struct {
+    void* caller;
+    size_t count;
+    size_t bytes;
+    uint32_t oldest;            // Lowest sequence number among them
+} KmallocSite;
+
+// A red zone found overwritten on kfree
+typedef struct {
+    void* ptr;
+    void* caller;
+    uint32_t seq;
+    size_t size;
+} KmallocCorruption;
+
+// Group live allocations by caller, largest byte total first. Returns
+// the number of sites written; the rest are left out.
+size_t kmalloc_sites(KmallocSite* sites, size_t max);
+
+// Sequence number the next kmalloc will get
+uint32_t kmalloc_sequence(void);
+
+// Live allocations that did not fit in the tracking table
+size_t kmalloc_untracked(void);
+
+// Copy up to max of the most recent red-zone hits, newest first.
+// Returns how many have been seen in total.
+size_t kmalloc_corruptions(KmallocCorruption* log, size_t max);
+#endif
+
+#endif // MEMORY_H
@@ -0,0 +1,31 @@
+#ifndef PAT_H
+#define PAT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Memory types, as encoded in the PAT and the MTRRs
+#define MEMTYPE_UC       0x00
+#define MEMTYPE_WC       0x01
+#define MEMTYPE_WT       0x04
+#define MEMTYPE_WP       0x05
+#define MEMTYPE_WB       0x06
+#define MEMTYPE_UC_MINUS 0x07
+
+// Program the PAT so that page entries with only PWT set select
+// write-combining. Must run before anything maps with PAGE_WRITE_THROUGH.
+bool pat_init(void);
+
+// Whether the PAT was programmed
+bool pat_enabled(void);
+
+// Page entry bits that select write-combining, or 0 without PAT
+uint32_t pat_write_combining_flags(void);
+
+// Variable-range MTRRs, the fallback on CPUs without PAT. base and size
+// must be a power-of-two sized, naturally aligned region. Returns the
+// slot used, or -1 if none is free or the type is not supported.
+int mtrr_add(uint64_t base, uint64_t size, uint8_t type);
+void mtrr_remove(int slot);
+
+#endif // PAT_H
@@ -6,4 +6,7 @@
 // Initialize the Programmable Interrupt Controller
 void init_pic(void);
 
+// Unmask one IRQ line (0-15)
+void pic_unmask(uint8_t irq);
+
 #endif /* _PIC_H */ 
\ No newline at end of file
@@ -0,0 +1,32 @@
+#ifndef PMM_H
+#define PMM_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "kernel.h"
+
+// Largest buddy block is 2^PMM_MAX_ORDER pages (4 MB)
+#define PMM_MAX_ORDER 10
+
+// Physical memory manager initialization
+void pmm_init(MultibootInfo* info);
+
+// Allocate 2^order physically contiguous page frames.
+// Returns the physical address of the first frame, or 0 if none are free.
+uintptr_t alloc_pages(unsigned int order);
+
+// Free a block previously returned by alloc_pages with the same order
+void free_pages(uintptr_t addr, unsigned int order);
+
+#define alloc_page() alloc_pages(0)
+#define free_page(addr) free_pages((addr), 0)
+
+// End of the boot-time frame descriptor array, which must stay identity mapped
+uintptr_t pmm_metadata_end(void);
+
+// Statistics
+size_t pmm_free_blocks(unsigned int order);
+size_t pmm_free_frames(void);
+size_t pmm_total_frames(void);
+
+#endif // PMM_H
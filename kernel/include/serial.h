@@ -0,0 +1,53 @@
+#ifndef SERIAL_H
+#define SERIAL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// 16550A UART driver for COM1-COM4. Output is queued in a ring and fed
+// to the 16-byte FIFO from the THRE interrupt, so writers never wait on
+// the line. Received bytes are queued by the RX interrupt.
+
+// Ports, as passed to the functions below
+#define SERIAL_COM1 0
+#define SERIAL_COM2 1
+#define SERIAL_COM3 2
+#define SERIAL_COM4 3
+#define SERIAL_PORTS 4
+
+// Ring sizes in bytes; powers of two
+#define SERIAL_TX_BUFFER 4096
+#define SERIAL_RX_BUFFER 256
+
+// Program a port for baud 8N1 with FIFOs on. Returns false if no UART
+// answers at the port's address.
+bool serial_init(unsigned int port, uint32_t baud);
+
+// Whether serial_init found the port
+bool serial_present(unsigned int port);
+
+// Queue bytes for transmission, turning '\n' into "\r\n". Bytes that do
+// not fit in the ring are dropped, and a note with the count is sent in
+// their place once there is room. Returns the number of input bytes
+// queued.
+size_t serial_write(unsigned int port, const char* data, size_t length);
+
+// Take up to max received bytes. Never blocks.
+size_t serial_read(unsigned int port, char* buffer, size_t max);
+
+// Move bytes between the rings and the UARTs without waiting. Covers
+// for the interrupts while they are off; call from idle loops.
+void serial_poll(void);
+
+// IRQ 3 and 4 handler
+void serial_handle_irq(uint8_t irq);
+
+// Write to the console port (CONFIG_SERIAL_PORT), if present
+void serial_console_write(const char* text, size_t length);
+
+// Panic path: drain the console port's queue and then text by polling,
+// with interrupts off and the ring bypassed
+void serial_panic_write(const char* text, size_t length);
+
+#endif // SERIAL_H
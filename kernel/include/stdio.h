@@ -10,4 +10,19 @@ int vsprintf(char* str, const char* format, va_list args);
 int snprintf(char* str, size_t size, const char* format, ...);
 int vsnprintf(char* str, size_t size, const char* format, va_list args);
 
-#endif // STDIO_H 
\ No newline at end of file
+// Longest kprintf message; anything past it is cut off
+#define KPRINTF_BUFFER 256
+
+// Receives each kprintf message whole
+typedef void (*KprintfSink)(const char* text, size_t length);
+
+// Format a message on the stack and write it out in one sink call, so
+// the terminal moves the hardware cursor once per message rather than
+// once per character. Output goes to the terminal unless redirected.
+int kprintf(const char* format, ...) __attribute__((format(printf, 1, 2)));
+int vkprintf(const char* format, va_list args);
+
+// Send kprintf output to sink (NULL for the terminal)
+void kprintf_set_sink(KprintfSink sink);
+
+#endif // STDIO_H
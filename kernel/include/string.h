@@ -2,10 +2,12 @@
 #define STRING_H
 
 #include <stddef.h>
+#include <stdint.h>
 
 // String manipulation
 void* memset(void* dest, int val, size_t count);
 void* memcpy(void* dest, const void* src, size_t count);
+void* memmove(void* dest, const void* src, size_t count);
 int memcmp(const void* ptr1, const void* ptr2, size_t count);
 char* strcpy(char* dest, const char* src);
 char* strncpy(char* dest, const char* src, size_t count);
@@ -18,4 +20,10 @@ char* strchr(const char* str, int ch);
 char* strrchr(const char* str, int ch);
 char* strstr(const char* str1, const char* str2);
 
+// Fill count 32-bit words with value, e.g. a run of pixels
+void memset32(uint32_t* dest, uint32_t value, size_t count);
+
+// Pick the memcpy/memset variants for this CPU; call after cpu_init
+void string_init(void);
+
 #endif // STRING_H 
\ No newline at end of file
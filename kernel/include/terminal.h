@@ -33,6 +33,7 @@ void terminal_clear(void);
 void terminal_set_color(uint8_t color);
 void terminal_put_char(char c);
 void terminal_write_string(const char* str);
+void terminal_write(const char* data, size_t size);
 void terminal_write_dec(uint32_t num);
 void terminal_put_pixel(int x, int y, uint32_t color);
 void terminal_draw_string(int x, int y, const char* str, uint32_t color);
@@ -41,6 +42,24 @@ void terminal_move_cursor_right(void);
 void terminal_delete_char(void);
 void terminal_putchar(char c);
 
+// Output is drawn into a RAM shadow of the screen. This copies the rows
+// changed since the last call to VGA memory and writes the cursor and
+// display start to the CRTC, if they changed; terminal_write and
+// terminal_write_string call it when they finish.
+void terminal_flush(void);
+
+// Receives a copy of all text written to the terminal
+typedef void (*TerminalMirror)(const char* text, size_t length);
+
+// Copy terminal text to mirror as well as the screen (NULL to stop),
+// so that a serial console sees the same output
+void terminal_set_mirror(TerminalMirror mirror);
+
+// Scrollback: move the view back (positive) or forward (negative) by
+// lines, or straight back to the live screen
+void terminal_scroll_view(int lines);
+void terminal_view_live(void);
+
 // VGA helper functions
 uint8_t vga_entry_color(uint8_t fg, uint8_t bg);
 
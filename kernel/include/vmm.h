@@ -0,0 +1,69 @@
+#ifndef VMM_H
+#define VMM_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// Page table entry flags
+#define PAGE_PRESENT 0x001
+#define PAGE_WRITE   0x002
+#define PAGE_USER    0x004
+#define PAGE_WRITE_THROUGH 0x008  // PWT, selects a PAT entry with PCD
+#define PAGE_CACHE_DISABLE 0x010  // PCD
+#define PAGE_LARGE   0x080  // Directory entry maps 4 MB (needs CR4.PSE)
+#define PAGE_GLOBAL  0x100  // Kept in the TLB across CR3 loads (needs CR4.PGE)
+
+// Build the kernel page directory and turn paging on
+bool vmm_init(void);
+
+// Map one 4 KB page. Page tables are allocated the first time a 4 MB
+// region is touched. Supervisor mappings are made global when PGE is
+// available. Remapping a present page invalidates its TLB entry.
+bool vmm_map(uintptr_t virt, uintptr_t phys, uint32_t flags);
+
+// Map a physically contiguous range. 4 MB pages are used where both
+// addresses are 4 MB aligned and PSE is available; the rest falls back
+// to 4 KB pages. Large mappings are permanent: vmm_unmap skips them.
+bool vmm_map_range(uintptr_t virt, uintptr_t phys, size_t size, uint32_t flags);
+
+// Unmap one 4 KB page and return the frame it pointed at (0 if none).
+// Page tables that become empty are freed. The caller is responsible for
+// flushing the unmapped page from the TLB, e.g. with tlb_flush_range().
+uintptr_t vmm_unmap(uintptr_t virt);
+
+// Replace the PWT/PCD caching bits of an already mapped range. A 4 MB
+// mapping that overlaps the range changes as a whole.
+bool vmm_set_cache(uintptr_t virt, size_t size, uint32_t cache);
+
+// Physical address behind a virtual address, or 0 if it is not mapped
+uintptr_t vmm_translate(uintptr_t virt);
+
+// Page-fault error code bits
+#define PF_PRESENT  0x01  // Protection violation (clear: page not present)
+#define PF_WRITE    0x02  // Write access
+#define PF_USER     0x04  // Fault in user mode
+#define PF_RESERVED 0x08  // Reserved bit set in a paging entry
+#define PF_FETCH    0x10  // Instruction fetch
+
+// Resolves a not-present fault at addr inside a reserved range. Returns
+// false if the access is invalid after all.
+typedef bool (*VmmFaultHandler)(uintptr_t addr);
+
+// Reserve [virt, virt + size) for demand paging. Pages are backed on
+// first touch, by handler if one is given and otherwise with a zeroed
+// frame mapped with flags.
+bool vmm_reserve(uintptr_t virt, size_t size, uint32_t flags, VmmFaultHandler handler);
+
+// Try to resolve a page fault. Returns false for faults that are not
+// first touches of reserved memory.
+bool vmm_handle_fault(uintptr_t addr, uint32_t error);
+
+// Whether addr lies in a reserved range
+bool vmm_is_reserved(uintptr_t addr);
+
+// Live 4 MB and 4 KB mappings
+size_t vmm_large_mappings(void);
+size_t vmm_small_mappings(void);
+
+#endif // VMM_H
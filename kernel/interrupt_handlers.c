@@ -4,13 +4,19 @@
 #include "../include/interrupt_handlers.h"
 #include "../include/irq.h"
 #include "../kernel/include/interrupt.h"
+#include "include/vmm.h"
+#include "include/asm.h"
+#include "include/fpu.h"
+#include "include/klog.h"
+#include "include/serial.h"
+#include <string.h>
 #include <stdint.h>
 #include "kernel.h"
 
 // External function declarations
 extern void init_terminal(void);
-extern void update_cursor(void);
 extern void terminal_write_string(const char* data);
+extern void terminal_set_mirror(void (*mirror)(const char* text, size_t length));
 extern void itoa(int value, char* str, int base);
 extern void init_pic(void);  // Declare external init_pic
 
@@ -45,27 +51,80 @@ void send_eoi(uint32_t int_no) {
     port_out_byte(0x20, 0x20); // Send EOI to master PIC
 }
 
+// Fatal reports go to the screen and, by polling, to the serial console.
+// The terminal's serial mirror is cut off so the text is not queued too.
+static void panic_write(const char* text) {
+    terminal_set_mirror(NULL);
+    terminal_write_string(text);
+    serial_panic_write(text, strlen(text));
+}
+
+// Print a 32-bit value as 8 hex digits
+static void write_hex(uint32_t value) {
+    char buf[11] = "0x";
+    for (int i = 0; i < 8; i++) {
+        buf[2 + i] = "0123456789ABCDEF"[(value >> (28 - i * 4)) & 0xF];
+    }
+    buf[10] = '\0';
+    panic_write(buf);
+}
+
+// Report a page fault that could not be resolved and halt
+static void page_fault_panic(struct interrupt_frame* frame, uint32_t addr) {
+    uint32_t error = frame->err_code;
+
+    panic_write("\nPAGE FAULT at ");
+    write_hex(addr);
+    panic_write(" (error ");
+    write_hex(error);
+    panic_write(")\n  ");
+    panic_write(error & PF_PRESENT ? "protection violation" : "page not present");
+    panic_write(error & PF_WRITE ? ", write" : ", read");
+    panic_write(error & PF_USER ? ", user mode" : ", kernel mode");
+    if (error & PF_RESERVED) panic_write(", reserved bit set");
+    if (error & PF_FETCH) panic_write(", instruction fetch");
+    panic_write("\n  EIP: ");
+    write_hex(frame->eip);
+    panic_write(vmm_is_reserved(addr) ? "\n  Address is in a reserved range\n"
+                                      : "\n  Address is not mapped or reserved\n");
+
+    for (;;) {
+        CLI();
+        HLT();
+    }
+}
+
 // ISR handler
 void isr_handler(struct interrupt_frame* frame) {
+    // The running context touched the FPU after a switch
+    if (frame->int_no == 7 && fpu_handle_nm()) return;
+
+    // First touches of demand-paged memory are resolved silently
+    if (frame->int_no == 14) {
+        uint32_t addr = READ_CR2();
+        if (vmm_handle_fault(addr, frame->err_code)) return;
+        page_fault_panic(frame, addr);
+    }
+
     char num_str[12]; // Buffer for integer to string conversion
-    terminal_write_string("Interrupt received: ");
+    panic_write("Interrupt received: ");
     itoa(frame->int_no, num_str, 10);
-    terminal_write_string(num_str);
-    terminal_write_string("\n");
-    terminal_write_string("Error code: ");
+    panic_write(num_str);
+    panic_write("\n");
+    panic_write("Error code: ");
     itoa(frame->err_code, num_str, 10);
-    terminal_write_string(num_str);
-    terminal_write_string("\n");
+    panic_write(num_str);
+    panic_write("\n");
 
     // Handle CPU exceptions (interrupts 0-31)
     if (frame->int_no < 32) {
-        terminal_write_string("Exception: ");
+        panic_write("Exception: ");
         if (frame->int_no < 16) {
-            terminal_write_string(exception_messages[frame->int_no]);
+            panic_write(exception_messages[frame->int_no]);
         } else {
-            terminal_write_string("Reserved Exception");
+            panic_write("Reserved Exception");
         }
-        terminal_write_string("\n");
+        panic_write("\n");
         
         // Halt the system
         for(;;);
@@ -78,11 +137,17 @@ void isr_handler(struct interrupt_frame* frame) {
 
 // IRQ handler
 void irq_handler(struct regs* r) {
-    char num_str[12]; // Buffer for integer to string conversion
-    terminal_write_string("IRQ received: ");
-    itoa(r->int_no, num_str, 10);
-    terminal_write_string(num_str);
-    terminal_write_string("\n");
+    // Serial IRQs come often under load; service them without logging
+    if (r->int_no == 35 || r->int_no == 36) {
+        serial_handle_irq((uint8_t)(r->int_no - 32));
+        send_eoi(r->int_no);
+        return;
+    }
+
+    // Logged rather than printed: klog only copies into its ring
+    if (r->int_no != 32) {
+        klog(KLOG_DEBUG, "IRQ %u received", r->int_no - 32);
+    }
 
     // Always send EOI first to prevent interrupt storms
     send_eoi(r->int_no);
@@ -90,9 +155,6 @@ void irq_handler(struct regs* r) {
     // Handle timer interrupt (IRQ0)
     if (r->int_no == 32) {
         timer_ticks++;
-        if (timer_ticks % 100 == 0) {  // Update cursor every second (assuming 100Hz timer)
-            update_cursor();
-        }
     }
     // Handle keyboard interrupt (IRQ1)
     else if (r->int_no == 33) {
@@ -111,11 +173,7 @@ void irq_handler(struct regs* r) {
     // Handle other IRQs (just acknowledge them)
     else {
         // Unhandled IRQ - just acknowledge it
-        terminal_write_string("Unhandled IRQ: ");
-        char irq_str[4];
-        itoa(r->int_no - 32, irq_str, 10);
-        terminal_write_string(irq_str);
-        terminal_write_string("\n");
+        klog(KLOG_WARN, "unhandled IRQ %u", r->int_no - 32);
     }
 }
 
@@ -1,6 +1,8 @@
 [BITS 32]
 global timer_irq_handler
 global keyboard_irq_handler
+global serial_irq3_handler
+global serial_irq4_handler
 
 extern keyboard_handler
 extern timer_handler
@@ -20,12 +22,26 @@ keyboard_irq_handler:
     push dword 33    ; Push IRQ number (32 + 1)
     jmp irq_common
 
+; COM2/COM4 IRQ handler (IRQ3)
+serial_irq3_handler:
+    push dword 0     ; Push dummy error code
+    push dword 35    ; Push IRQ number (32 + 3)
+    jmp irq_common
+
+; COM1/COM3 IRQ handler (IRQ4)
+serial_irq4_handler:
+    push dword 0     ; Push dummy error code
+    push dword 36    ; Push IRQ number (32 + 4)
+    jmp irq_common
+
 ; Common IRQ handler
 irq_common:
     pusha           ; Push all registers
 
-    mov ax, ds      ; Save data segment
-    push eax
+    push ds         ; Save segment registers (struct interrupt_frame)
+    push es
+    push fs
+    push gs
 
     mov ax, 0x10    ; Load kernel data segment
     mov ds, ax
@@ -33,13 +49,14 @@ irq_common:
     mov fs, ax
     mov gs, ax
 
+    push esp        ; Pass the frame to the C handler
     call irq_handler
+    add esp, 4
 
-    pop eax         ; Restore data segment
-    mov ds, ax
-    mov es, ax
-    mov fs, ax
-    mov gs, ax
+    pop gs          ; Restore segment registers
+    pop fs
+    pop es
+    pop ds
 
     popa            ; Restore registers
     add esp, 8      ; Clean up error code and IRQ number
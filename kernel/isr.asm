@@ -27,8 +27,10 @@ isr%1:
 isr_common:
     pusha           ; Push all registers
 
-    mov ax, ds      ; Save data segment
-    push eax
+    push ds         ; Save segment registers (struct interrupt_frame)
+    push es
+    push fs
+    push gs
 
     mov ax, 0x10    ; Load kernel data segment
     mov ds, ax
@@ -36,13 +38,14 @@ isr_common:
     mov fs, ax
     mov gs, ax
 
+    push esp        ; Pass the frame to the C handler
     call isr_handler
+    add esp, 4
 
-    pop eax         ; Restore data segment
-    mov ds, ax
-    mov es, ax
-    mov fs, ax
-    mov gs, ax
+    pop gs          ; Restore segment registers
+    pop fs
+    pop es
+    pop ds
 
     popa            ; Restore registers
     add esp, 8      ; Clean up error code and ISR number
@@ -70,7 +73,7 @@ ISR_NOERRCODE 15
 load_idt:
     push ebp
     mov ebp, esp
-    mov eax, [ebp + 4]  ; Get pointer to IDT
+    mov eax, [ebp + 8]  ; Get pointer to IDT
     lidt [eax]          ; Load IDT
     pop ebp
     ret
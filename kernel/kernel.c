@@ -4,9 +4,17 @@
 #include <string.h>
 #include "include/stdlib.h"
 #include "include/stdio.h"
+#include "include/klog.h"
+#include "include/serial.h"
 #include "include/io.h"
+#include "include/asm.h"
 #include "include/memory.h"
+#include "include/arena.h"
+#include "include/pmm.h"
+#include "include/vmm.h"
 #include "include/cpu.h"
+#include "include/pat.h"
+#include "include/graphics.h"
 #include "include/pic.h"
 #include "include/terminal.h"
 #include "include/kernel.h"
@@ -71,21 +79,20 @@ extern uint64_t end;
 // External assembly functions
 extern void enable_interrupts(void);
 extern void halt_cpu(void);
-extern void enable_paging(uint64_t* page_dir);
 
 // Function declarations
 static void early_print(const char* str, uint8_t color);
 void detect_memory(MultibootInfo* mboot_ptr);
 void handle_command(const char* command);
+static void run_command(const char* command);
 void kernel_init(void);
-bool init_paging(void);
 void itoa(int value, char* str, int base);
 void print_help(void);
-
-// Global system state
-uint64_t* page_directory = NULL;
-uint64_t* page_tables[1024] = {NULL};
-bool pages_used[MAX_PAGES] = {false};
+static void gfxbench(void);
+static void meminfo(void);
+#if CONFIG_MEMORY_DEBUG
+static void memleaks(void);
+#endif
 
 // Terminal state is managed in terminal.c
 
@@ -117,40 +124,30 @@ static void early_print(const char* str, uint8_t color) {
 
 // Memory detection function
 void detect_memory(MultibootInfo* mboot_ptr) {
-    char buf[32];
-
-    early_print("Memory Detection Started...\n", VGA_COLOR_WHITE);
+    kprintf("Memory Detection Started...\n");
 
     // Check if memory info is available
     if (!(mboot_ptr->flags & (1 << 0))) {
-        early_print("ERROR: No basic memory information available!\n", VGA_COLOR_RED);
+        terminal_set_color(VGA_COLOR_RED);
+        kprintf("ERROR: No basic memory information available!\n");
+        terminal_set_color(VGA_COLOR_LIGHT_GREY);
         return;
     }
 
     // Print basic memory info
-    early_print("Basic Memory Info:\n", VGA_COLOR_WHITE);
-    early_print("Lower memory: ", VGA_COLOR_WHITE);
-    itoa(mboot_ptr->mem_lower, buf, 10);
-    early_print(buf, VGA_COLOR_WHITE);
-    early_print(" KB\n", VGA_COLOR_WHITE);
-
-    early_print("Upper memory: ", VGA_COLOR_WHITE);
-    itoa(mboot_ptr->mem_upper, buf, 10);
-    early_print(buf, VGA_COLOR_WHITE);
-    early_print(" KB\n", VGA_COLOR_WHITE);
-
     total_memory = mboot_ptr->mem_lower + mboot_ptr->mem_upper;
-    early_print("Total memory: ", VGA_COLOR_WHITE);
-    itoa(total_memory / 1024, buf, 10);
-    early_print(buf, VGA_COLOR_WHITE);
-    early_print(" MB\n", VGA_COLOR_WHITE);
+    kprintf("Basic Memory Info:\n"
+            "Lower memory: %u KB\n"
+            "Upper memory: %u KB\n"
+            "Total memory: %u MB\n",
+            mboot_ptr->mem_lower, mboot_ptr->mem_upper, total_memory / 1024);
 
     // Check for detailed memory map
     if (mboot_ptr->flags & (1 << 6)) {
         struct memory_map_entry* mmap = (struct memory_map_entry*)(uintptr_t)mboot_ptr->mmap_addr;
         uintptr_t end_addr = (uintptr_t)mboot_ptr->mmap_addr + mboot_ptr->mmap_length;
 
-        early_print("\nDetailed Memory Map:\n", VGA_COLOR_WHITE);
+        kprintf("\nDetailed Memory Map:\n");
 
         while ((uintptr_t)mmap < end_addr) {
             if (mmap->type == 1) {  // Available memory
@@ -159,49 +156,22 @@ void detect_memory(MultibootInfo* mboot_ptr) {
                 used_memory += mmap->length;
             }
 
-            early_print("Region: Base=0x", VGA_COLOR_WHITE);
-            // Print upper 32 bits of base address
-            itoa((uint32_t)(mmap->base_addr >> 32), buf, 16);
-            early_print(buf, VGA_COLOR_WHITE);
-            // Print lower 32 bits of base address
-            itoa((uint32_t)(mmap->base_addr & 0xFFFFFFFF), buf, 16);
-            early_print(buf, VGA_COLOR_WHITE);
-            
-            early_print(" Length=0x", VGA_COLOR_WHITE);
-            // Print upper 32 bits of length
-            itoa((uint32_t)(mmap->length >> 32), buf, 16);
-            early_print(buf, VGA_COLOR_WHITE);
-            // Print lower 32 bits of length
-            itoa((uint32_t)(mmap->length & 0xFFFFFFFF), buf, 16);
-            early_print(buf, VGA_COLOR_WHITE);
-            
-            early_print(" Type=", VGA_COLOR_WHITE);
-            itoa(mmap->type, buf, 10);
-            early_print(buf, VGA_COLOR_WHITE);
-            early_print("\n", VGA_COLOR_WHITE);
+            kprintf("Region: Base=0x%016llx Length=0x%016llx Type=%u\n",
+                    (unsigned long long)mmap->base_addr,
+                    (unsigned long long)mmap->length, mmap->type);
 
             mmap = (struct memory_map_entry*)((uintptr_t)mmap + sizeof(struct memory_map_entry));
         }
 
         // Print memory summary
-        early_print("\nMemory Summary:\n", VGA_COLOR_WHITE);
-        early_print("Total Memory: ", VGA_COLOR_WHITE);
-        itoa(total_memory / 1024, buf, 10);
-        early_print(buf, VGA_COLOR_WHITE);
-        early_print(" MB\n", VGA_COLOR_WHITE);
-
-        early_print("Used Memory: ", VGA_COLOR_WHITE);
-        itoa(used_memory / (1024 * 1024), buf, 10);
-        early_print(buf, VGA_COLOR_WHITE);
-        early_print(" MB\n", VGA_COLOR_WHITE);
-
-        early_print("Free Memory: ", VGA_COLOR_WHITE);
-        itoa(free_memory / (1024 * 1024), buf, 10);
-        early_print(buf, VGA_COLOR_WHITE);
-        early_print(" MB\n", VGA_COLOR_WHITE);
+        kprintf("\nMemory Summary:\n"
+                "Total Memory: %u MB\n"
+                "Used Memory: %u MB\n"
+                "Free Memory: %u MB\n",
+                total_memory / 1024, used_memory / (1024 * 1024), free_memory / (1024 * 1024));
     }
 
-    early_print("Memory Detection Complete\n", VGA_COLOR_WHITE);
+    kprintf("Memory Detection Complete\n");
 }
 
 // Initialize kernel subsystems
@@ -259,9 +229,40 @@ void kernel_main(uint32_t magic, MultibootInfo* info) {
     multiboot_info = info;
     multiboot_magic = magic;
     
+    // Exception handlers first, so that page faults can be resolved
+    init_idt();
+
+    // Detect CPU features before paging relies on them
+    cpu_init();
+    string_init();
+    pat_init();
+
+    // Initialize memory
+    pmm_init(info);
+    if (!vmm_init()) {
+        // The heap lives in mapped virtual memory, so nothing past
+        // this point can run
+        early_print("ERROR: Failed to set up paging\n", VGA_COLOR_RED);
+        for (;;) {
+            CLI();
+            HLT();
+        }
+    }
+    memory_init();
+    graphics_set_write_combining(true);
+
     // Initialize terminal
     terminal_initialize();
+#if CONFIG_SERIAL_DEBUG
+    if (serial_init(CONFIG_SERIAL_PORT, CONFIG_SERIAL_BAUD)) {
+        terminal_set_mirror(serial_console_write);
+    } else {
+        klog(KLOG_WARN, "serial: no UART on COM%d", CONFIG_SERIAL_PORT + 1);
+    }
+#endif
     terminal_write_string("Welcome to ArcOS!\n");
+    kprintf("Paging: %zu large (4 MB), %zu small (4 KB) mappings\n",
+            vmm_large_mappings(), vmm_small_mappings());
     terminal_write_string("Type 'help' for available commands.\n\n");
 
     // Initialize keyboard
@@ -270,6 +271,10 @@ void kernel_main(uint32_t magic, MultibootInfo* info) {
     // Main loop
     char command[256];
     while (1) {
+        // Show what interrupt handlers logged since the last prompt, and
+        // give the serial console a chance to drain
+        klog_flush();
+        serial_poll();
         terminal_write_string("> ");
         if (keyboard_getline(command, sizeof(command)) > 0) {
             handle_command(command);
@@ -277,17 +282,40 @@ void kernel_main(uint32_t magic, MultibootInfo* info) {
     }
 }
 
+// Scratch memory that lives until the current command finishes
+static Arena* command_arena = NULL;
+
 // Handle user commands
 void handle_command(const char* command) {
+    if (!command_arena) {
+        command_arena = arena_create(0);
+        if (!command_arena) {
+            terminal_write_string("Out of memory\n");
+            return;
+        }
+    }
+
+    ArenaMark mark = arena_mark(command_arena);
+    run_command(command);
+    arena_reset(command_arena, mark);
+}
+
+// Dispatch a single command
+static void run_command(const char* command) {
     if (strcmp(command, "help") == 0) {
         print_help();
     }
     else if (strcmp(command, "install") == 0) {
-        install_target_t targets[MAX_INSTALL_TARGETS];
+        install_target_t* targets = arena_alloc(command_arena, sizeof(install_target_t) * MAX_INSTALL_TARGETS, 0);
         int target_count = 0;
         install_status_t status;
         install_config_t config;
 
+        if (!targets) {
+            terminal_write_string("Out of memory\n");
+            return;
+        }
+
         // Initialize installer
         if (!installer_init()) {
             terminal_write_string("Failed to initialize installer\n");
@@ -304,18 +332,11 @@ void handle_command(const char* command) {
         // Display available targets
         terminal_write_string("Available installation targets:\n");
         for (int i = 0; i < target_count; i++) {
-            terminal_write_string(targets[i].model);
-            terminal_write_string(" (");
-            terminal_write_string(targets[i].drive);
-            terminal_write_string(")\n");
+            kprintf("%s (%s)\n", targets[i].model, targets[i].drive);
         }
 
         // Get user selection
-        terminal_write_string("Select target (0-");
-        char num[8];
-        sprintf(num, "%d", target_count - 1);
-        terminal_write_string(num);
-        terminal_write_string("): ");
+        kprintf("Select target (0-%d): ", target_count - 1);
 
         char selection_str[8];
         if (keyboard_getline(selection_str, sizeof(selection_str)) <= 0) {
@@ -344,6 +365,20 @@ void handle_command(const char* command) {
     else if (strcmp(command, "clear") == 0) {
         terminal_clear();
     }
+    else if (strcmp(command, "gfxbench") == 0) {
+        gfxbench();
+    }
+    else if (strcmp(command, "meminfo") == 0) {
+        meminfo();
+    }
+    else if (strcmp(command, "dmesg") == 0) {
+        klog_dump();
+    }
+#if CONFIG_MEMORY_DEBUG
+    else if (strcmp(command, "memleaks") == 0) {
+        memleaks();
+    }
+#endif
     else if (strcmp(command, "exit") == 0) {
         terminal_write_string("Goodbye!\n");
         // TODO: Implement proper shutdown
@@ -362,50 +397,141 @@ void print_help(void) {
     terminal_write_string("  help    - Show this help message\n");
     terminal_write_string("  install - Start system installation\n");
     terminal_write_string("  clear   - Clear the screen\n");
+    terminal_write_string("  gfxbench - Time framebuffer clears and blits\n");
+    terminal_write_string("  meminfo - Show heap statistics and fragmentation\n");
+    terminal_write_string("  dmesg   - Show the kernel log\n");
+#if CONFIG_MEMORY_DEBUG
+    terminal_write_string("  memleaks - List live allocations by call site\n");
+#endif
     terminal_write_string("  exit    - Exit the system\n");
 }
 
-// Initialize terminal is defined in terminal.c
+// Show kmalloc counters, heap occupancy and free-space fragmentation
+static void meminfo(void) {
+    KheapStats stats;
+    kheap_get_stats(&stats);
 
-// Initialize paging with error checking
-bool init_paging(void) {
-    early_print("Initializing paging...\n", VGA_COLOR_WHITE);
-    
-    // Allocate page directory
-    page_directory = (uint64_t*)kmalloc(PAGE_SIZE);
-    if (!page_directory) {
-        early_print("ERROR: Failed to allocate page directory\n", VGA_COLOR_RED);
-        return false;
+    kprintf("class               allocs     frees  failed    live B    peak B\n");
+    for (size_t i = 0; i <= KMALLOC_CLASSES; i++) {
+        const KmallocStats* c = &stats.classes[i];
+        kprintf("%-14s%12zu%10zu%8zu%10zu%10zu\n", c->name, c->allocs, c->frees,
+                c->failures, c->live_bytes, c->peak_bytes);
     }
-    memset(page_directory, 0, PAGE_SIZE);
-
-    // Allocate page tables
-    for (int i = 0; i < 1024; i++) {
-        page_tables[i] = (uint64_t*)kmalloc(PAGE_SIZE);
-        if (!page_tables[i]) {
-            early_print("ERROR: Failed to allocate page table\n", VGA_COLOR_RED);
-            kfree(page_directory);
-            return false;
-        }
-        memset(page_tables[i], 0, PAGE_SIZE);
+
+    kprintf("heap: %zu KB reserved, %zu KB mapped, %zu KB free (%zu KB mapped)\n",
+            stats.heap_pages * PAGE_SIZE / 1024, stats.mapped_pages * PAGE_SIZE / 1024,
+            stats.free_pages * PAGE_SIZE / 1024, stats.free_mapped_pages * PAGE_SIZE / 1024);
+    kprintf("free runs: %zu, largest %zu pages, fragmentation %u%%\n",
+            stats.free_runs, stats.largest_free_run, stats.fragmentation);
+
+    char line[KPRINTF_BUFFER];
+    size_t len = snprintf(line, sizeof(line), "free run pages:");
+    for (size_t i = 0; i < KHEAP_HISTOGRAM_BUCKETS && len < sizeof(line); i++) {
+        len += snprintf(line + len, sizeof(line) - len, " %u%s:%zu", 1u << i,
+                        i + 1 < KHEAP_HISTOGRAM_BUCKETS ? "" : "+", stats.free_histogram[i]);
     }
+    kprintf("%s\n", line);
+
+    kprintf("physical: %zu KB free of %zu KB\n",
+            pmm_free_frames() * PAGE_SIZE / 1024, pmm_total_frames() * PAGE_SIZE / 1024);
+}
+
+#if CONFIG_MEMORY_DEBUG
+// Call sites shown by memleaks
+#define MEMLEAKS_SITES 16
+
+// List live kmalloc allocations grouped by call site, and any red zones
+// found overwritten on kfree
+static void memleaks(void) {
+    KmallocSite sites[MEMLEAKS_SITES];
+    size_t count = kmalloc_sites(sites, MEMLEAKS_SITES);
 
-    // Map first 4MB of memory
-    for (int i = 0; i < 1024; i++) {
-        page_tables[0][i] = (i * PAGE_SIZE) | 3;  // Present, read/write
+    kprintf("caller          allocs       bytes  oldest seq\n");
+    for (size_t i = 0; i < count; i++) {
+        kprintf("%p%12zu%12zu%12u\n", sites[i].caller, sites[i].count,
+                sites[i].bytes, sites[i].oldest);
     }
 
-    // Map page directory
-    page_directory[0] = ((uintptr_t)page_tables[0]) | 3;  // Present, read/write
-    page_directory[1023] = ((uintptr_t)page_directory) | 3;  // Present, read/write
-    
-    // Enable paging
-    enable_paging(page_directory);
-    
-    early_print("Paging enabled\n", VGA_COLOR_WHITE);
-    return true;
+    kprintf("next seq %u, untracked %zu\n", kmalloc_sequence(), kmalloc_untracked());
+
+    KmallocCorruption log[4];
+    size_t hits = kmalloc_corruptions(log, 4);
+    if (hits == 0) return;
+
+    terminal_set_color(VGA_COLOR_LIGHT_RED);
+    kprintf("%zu red zone(s) overwritten, latest:\n", hits);
+    for (size_t i = 0; i < hits && i < 4; i++) {
+        kprintf("  %p size %zu from %p seq %u\n", log[i].ptr, log[i].size,
+                log[i].caller, log[i].seq);
+    }
+    terminal_set_color(VGA_COLOR_LIGHT_GREY);
+}
+#endif
+
+// Frames drawn per gfxbench measurement
+#define GFXBENCH_FRAMES 16
+
+// Print a cycle count as kilocycles per frame
+static uint32_t print_bench(const char* label, uint64_t cycles) {
+    uint32_t per_frame = (uint32_t)(cycles >> 10) / GFXBENCH_FRAMES;
+    kprintf("%s%u Kcycles/frame\n", label, per_frame);
+    return per_frame ? per_frame : 1;
+}
+
+// Print before/after as a speedup with one decimal
+static void print_speedup(uint32_t before, uint32_t after) {
+    uint32_t tenths = before * 10 / after;
+    kprintf("  speedup: %u.%ux\n", tenths / 10, tenths % 10);
 }
 
+// Time full-screen clears and blits with the framebuffer mapped with
+// default caching and then write-combining
+static void gfxbench(void) {
+    if (!graphics_init()) {
+        terminal_write_string("gfxbench: no VBE framebuffer\n");
+        return;
+    }
+
+    uint16_t width = graphics_get_width();
+    uint16_t height = graphics_get_height();
+    uint32_t* image = (uint32_t*)kmalloc((size_t)width * height * sizeof(uint32_t));
+    if (!image) {
+        graphics_disable();
+        terminal_write_string("gfxbench: out of memory\n");
+        return;
+    }
+    for (uint32_t i = 0; i < (uint32_t)width * height; i++) {
+        image[i] = 0xFF000000 | (i * 0x010203);
+    }
+
+    graphics_set_write_combining(false);
+    uint64_t clear_default = graphics_bench_clear(GFXBENCH_FRAMES);
+    uint64_t blit_default = graphics_bench_blit(image, GFXBENCH_FRAMES);
+
+    bool wc = graphics_set_write_combining(true);
+    uint64_t clear_wc = graphics_bench_clear(GFXBENCH_FRAMES);
+    uint64_t blit_wc = graphics_bench_blit(image, GFXBENCH_FRAMES);
+
+    kfree(image);
+    graphics_disable();
+    terminal_clear();
+
+    terminal_write_string(pat_enabled() ? "Write-combining via PAT: " : "Write-combining via MTRR: ");
+    terminal_write_string(wc ? "on\n" : "unavailable\n");
+
+    terminal_write_string("graphics_clear\n");
+    uint32_t before = print_bench("  default: ", clear_default);
+    uint32_t after = print_bench("  WC:      ", clear_wc);
+    print_speedup(before, after);
+
+    terminal_write_string("graphics_blit\n");
+    before = print_bench("  default: ", blit_default);
+    after = print_bench("  WC:      ", blit_wc);
+    print_speedup(before, after);
+}
+
+// Initialize terminal is defined in terminal.c
+
 // Convert integer to string
 void itoa(int value, char* str, int base) {
     char* ptr = str, *ptr1 = str, tmp_char;
@@ -1,6 +1,8 @@
 #include "include/keyboard.h"
 #include "include/io.h"
 #include "include/terminal.h"
+#include "include/serial.h"
+#include "../include/config.h"
 #include <stdbool.h>
 
 // Command buffer
@@ -20,6 +22,9 @@ extern size_t command_pos;
 #define ALT_PRESSED 0x38
 #define ALT_RELEASED 0xB8
 
+// Lines moved per Shift+PgUp/PgDn
+#define SCROLLBACK_PAGE 12
+
 // Keyboard state
 static bool shift_pressed = false;
 static bool caps_lock = false;
@@ -92,6 +97,9 @@ bool keyboard_is_special_key(uint8_t scancode) {
 }
 
 uint8_t keyboard_get_scancode(void) {
+    // Bring the screen up to date before waiting
+    terminal_flush();
+
     // Wait for keyboard data with timeout
     int timeout = 100000;  // Arbitrary timeout value
     while (timeout > 0 && (port_in_byte(KEYBOARD_STATUS_PORT) & 1) == 0) {
@@ -144,17 +152,62 @@ bool keyboard_process_scancode(uint8_t scancode, char* c) {
     }
 }
 
+// Next character typed on the serial console, or 0. Enter arrives as
+// CR or CR LF and Backspace as DEL.
+static char serial_getchar(void) {
+    static bool after_cr = false;
+    char c;
+    if (!serial_read(CONFIG_SERIAL_PORT, &c, 1)) return 0;
+
+    bool was_cr = after_cr;
+    after_cr = c == '\r';
+    if (c == '\n' && was_cr) return 0;
+
+    if (c == '\r') {
+        c = '\n';
+    } else if (c == 0x7F) {
+        c = '\b';
+    }
+    return c;
+}
+
 char keyboard_getchar(void) {
     uint8_t scancode;
     
-    // Wait for key press
-    while (!(port_in_byte(KEYBOARD_STATUS_PORT) & 0x01));
+    // Bring the screen up to date before waiting
+    terminal_flush();
+
+    // Wait for a key press or serial input, keeping serial output moving
+    // meanwhile since interrupts are off
+    while (!(port_in_byte(KEYBOARD_STATUS_PORT) & 0x01)) {
+        serial_poll();
+        char c = serial_getchar();
+        if (c) {
+            terminal_view_live();
+            return c;
+        }
+    }
     
     // Read scancode
     scancode = port_in_byte(KEYBOARD_DATA_PORT);
+
+    // Shift+PgUp/PgDn page through the terminal scrollback
+    if (scancode == KEY_LEFT_SHIFT || scancode == KEY_RIGHT_SHIFT) {
+        shift_pressed = true;
+        return 0;
+    }
+    if (scancode == (KEY_LEFT_SHIFT | KEY_RELEASED) || scancode == (KEY_RIGHT_SHIFT | KEY_RELEASED)) {
+        shift_pressed = false;
+        return 0;
+    }
+    if (shift_pressed && (scancode == KEY_PAGE_UP || scancode == KEY_PAGE_DOWN)) {
+        terminal_scroll_view(scancode == KEY_PAGE_UP ? SCROLLBACK_PAGE : -SCROLLBACK_PAGE);
+        return 0;
+    }
     
     // Convert scancode to ASCII
-    if (scancode < sizeof(scancode_to_ascii)) {
+    if (scancode < sizeof(scancode_to_ascii) && scancode_to_ascii[scancode]) {
+        terminal_view_live();
         return scancode_to_ascii[scancode];
     }
     
@@ -246,7 +299,8 @@ void keyboard_handler(void) {
     port_out_byte(0x20, 0x20);  // Send EOI to master PIC
 }
 
-// Get line from keyboard
+// Get line from keyboard. Serial terminals leave echoing to the host,
+// so the line is echoed to the serial console as it is edited.
 int keyboard_getline(char* buffer, int max_length) {
     int i = 0;
     char c;
@@ -255,15 +309,19 @@ int keyboard_getline(char* buffer, int max_length) {
         c = keyboard_getchar();
         
         if (c == '\n') {
+            serial_console_write("\n", 1);
             buffer[i] = '\0';
             return i;
         } else if (c == '\b') {
+            // Nothing to erase must not eat into the prompt
             if (i > 0) {
                 i--;
                 buffer[i] = '\0';
+                serial_console_write("\b \b", 3);
             }
         } else if (c != 0) {
             buffer[i++] = c;
+            serial_console_write(&c, 1);
         }
     }
     
@@ -0,0 +1,164 @@
+#include "include/klog.h"
+#include "include/stdio.h"
+#include "include/string.h"
+#include "include/asm.h"
+#include "../include/config.h"
+#include <stdbool.h>
+
+// Ring size in records; a power of two
+#define KLOG_RECORDS CONFIG_KLOG_RECORDS
+#define KLOG_MASK (KLOG_RECORDS - 1)
+
+#if KLOG_RECORDS & KLOG_MASK
+#error "CONFIG_KLOG_RECORDS must be a power of two"
+#endif
+
+// Ring slot, 128 bytes. committed is seq + 1 once record seq is
+// complete; while a writer fills the slot it holds some other value.
+typedef struct {
+    volatile uint32_t committed;
+    uint8_t level;
+    uint8_t length;
+    uint16_t reserved;
+    uint64_t timestamp;
+    char text[KLOG_TEXT_MAX];
+} KlogSlot;
+
+// Outcome of reading one record back
+typedef enum {
+    KLOG_READ_OK,
+    KLOG_READ_PENDING,          // Reserved but not yet written
+    KLOG_READ_LOST              // Overwritten by a newer record
+} KlogRead;
+
+static KlogSlot ring[KLOG_RECORDS];
+
+// Next sequence number to hand out
+static volatile uint32_t klog_head = 0;
+
+// Next record klog_flush will print
+static uint32_t console_seq = 0;
+static KlogLevel console_level = KLOG_INFO;
+
+static const char* const level_prefix[] = { "error: ", "warning: ", "", "" };
+
+// Claim a sequence number and copy the message into its slot. A writer
+// interrupted halfway leaves its slot uncommitted, so readers stop there
+// instead of seeing half a record.
+static void klog_write(KlogLevel level, const char* text, size_t length) {
+    if (length > KLOG_TEXT_MAX) length = KLOG_TEXT_MAX;
+
+    uint32_t seq = __atomic_fetch_add(&klog_head, 1, __ATOMIC_RELAXED);
+    KlogSlot* slot = &ring[seq & KLOG_MASK];
+
+    __atomic_store_n(&slot->committed, seq, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    slot->level = (uint8_t)level;
+    slot->length = (uint8_t)length;
+    slot->timestamp = rdtsc();
+    memcpy(slot->text, text, length);
+
+    __atomic_store_n(&slot->committed, seq + 1, __ATOMIC_RELEASE);
+}
+
+// Copy record seq out of the ring. The commit word is checked again
+// after the copy, in case a writer lapped the reader meanwhile.
+static KlogRead klog_read(uint32_t seq, KlogEntry* entry) {
+    uint32_t head = __atomic_load_n(&klog_head, __ATOMIC_ACQUIRE);
+    if (head - seq > KLOG_RECORDS) return KLOG_READ_LOST;
+
+    KlogSlot* slot = &ring[seq & KLOG_MASK];
+    uint32_t committed = __atomic_load_n(&slot->committed, __ATOMIC_ACQUIRE);
+    if (committed != seq + 1) return KLOG_READ_PENDING;
+
+    entry->seq = seq;
+    entry->level = (KlogLevel)slot->level;
+    entry->length = slot->length;
+    entry->timestamp = slot->timestamp;
+    memcpy(entry->text, slot->text, entry->length);
+
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (slot->committed != committed) return KLOG_READ_LOST;
+    return KLOG_READ_OK;
+}
+
+// Print one record with its timestamp in kilocycles
+static void klog_print(const KlogEntry* entry) {
+    kprintf("[%10llu] %s%.*s\n", (unsigned long long)(entry->timestamp >> 10),
+            level_prefix[entry->level], (int)entry->length, entry->text);
+}
+
+// Append a message at the given level
+void vklog(KlogLevel level, const char* format, va_list args) {
+    char text[KLOG_TEXT_MAX + 1];
+    int length = vsnprintf(text, sizeof(text), format, args);
+    if (length < 0) return;
+
+    // The console adds its own line breaks
+    size_t count = (size_t)length < KLOG_TEXT_MAX ? (size_t)length : KLOG_TEXT_MAX;
+    if (count && text[count - 1] == '\n') count--;
+
+    klog_write(level, text, count);
+}
+
+// printf-style front end to vklog
+void klog(KlogLevel level, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    vklog(level, format, args);
+    va_end(args);
+}
+
+// Print records not yet shown on the console
+void klog_flush(void) {
+    uint32_t lost = 0;
+    KlogEntry entry;
+
+    for (;;) {
+        uint32_t head = __atomic_load_n(&klog_head, __ATOMIC_ACQUIRE);
+        if (console_seq == head) break;
+
+        KlogRead result = klog_read(console_seq, &entry);
+        if (result == KLOG_READ_PENDING) break;
+        if (result == KLOG_READ_LOST) {
+            // Skip to the oldest record still in the ring
+            uint32_t oldest = head - KLOG_RECORDS;
+            uint32_t skip = head - console_seq > KLOG_RECORDS ? oldest - console_seq : 1;
+            lost += skip;
+            console_seq += skip;
+            continue;
+        }
+
+        if (lost) {
+            kprintf("klog: %u messages lost\n", lost);
+            lost = 0;
+        }
+        if (entry.level <= console_level) {
+            klog_print(&entry);
+        }
+        console_seq++;
+    }
+
+    if (lost) {
+        kprintf("klog: %u messages lost\n", lost);
+    }
+}
+
+// Most verbose level klog_flush prints
+void klog_set_console_level(KlogLevel level) {
+    console_level = level;
+}
+
+// Print every record still in the ring, at all levels
+void klog_dump(void) {
+    uint32_t head = __atomic_load_n(&klog_head, __ATOMIC_ACQUIRE);
+    uint32_t seq = head > KLOG_RECORDS ? head - KLOG_RECORDS : 0;
+    KlogEntry entry;
+
+    for (; seq != head; seq++) {
+        if (klog_read(seq, &entry) == KLOG_READ_OK) {
+            klog_print(&entry);
+        }
+    }
+}
@@ -1,72 +1,1004 @@
 #include "include/memory.h"
+#include "../include/config.h"
+#include "include/pmm.h"
+#include "include/vmm.h"
+#include "include/cpu.h"
 #include <stdint.h>
 #include <stdbool.h>
 #include <string.h>
 
-// Simple memory block structure
-typedef struct MemoryBlock {
-    size_t size;
-    bool used;
-    struct MemoryBlock* next;
-} MemoryBlock;
+// Page descriptor types
+#define PAGE_TYPE_FREE  0
+#define PAGE_TYPE_SLAB  1
+#define PAGE_TYPE_LARGE 2
 
-// Memory pool
-static uint8_t memory_pool[PAGE_SIZE * MAX_PAGES];
-static MemoryBlock* free_list = NULL;
+// The kernel heap lives in this virtual range and grows on demand
+#define KHEAP_START 0xD0000000
+#define KHEAP_MAX_PAGES CONFIG_KHEAP_MAX_PAGES
+
+// Largest request the heap could ever hold. Anything bigger is refused
+// before it is rounded up to pages, which would wrap.
+#define KHEAP_MAX_SIZE ((size_t)KHEAP_MAX_PAGES * PAGE_SIZE)
+
+// A slab is sized to hold at least this many objects
+#define SLAB_MIN_OBJECTS 8
+
+// Default object alignment
+#define KMALLOC_ALIGN 8
+
+// Page-run placement policy. CONFIG_HEAP_NEXT_FIT selects next fit over a
+// single free list; otherwise free runs are kept in power-of-two size bins
+// (segregated fits) and the first bin that can satisfy a request is used.
+#if CONFIG_HEAP_NEXT_FIT
+#define FREE_BINS 1
+#else
+#define FREE_BINS 11
+#endif
+
+struct Slab;
+
+// Per-page descriptor for the heap pool. The first and last descriptors
+// of every run carry its type and length, so a run's neighbours can be
+// found and merged without walking any list. Every page of a large run
+// points at its first page, so a fault inside the run finds it at once.
+typedef struct PageDesc {
+    uint8_t type;
+    bool mapped;                    // A frame is mapped behind this page
+    bool clean;                     // Mapped and known to be all zeroes
+    size_t pages;                   // Run length, valid on the first and last page of a run
+    struct PageDesc* head;          // First page of the large run holding this page, or NULL
+    union {
+        struct {
+            struct PageDesc* next;  // Free list links (free runs only)
+            struct PageDesc* prev;
+            size_t backed;          // Mapped pages in the run (free runs only)
+        };
+        struct Slab* slab;          // Owning slab (slab pages only)
+    };
+} PageDesc;
+
+// Slab header, stored at the start of the slab's first page
+typedef struct Slab {
+    kmem_cache_t* cache;
+    struct Slab* prev;
+    struct Slab* next;
+    void* free_objects;
+    uint16_t inuse;
+} Slab;
+
+// Object cache
+struct kmem_cache {
+    const char* name;
+    size_t object_size;
+    size_t first_offset;
+    size_t slab_pages;
+    uint16_t objects_per_slab;
+    Slab* partial;              // Slabs with at least one free object
+    Slab* full;                 // Slabs with no free objects
+    Slab* empty;                // One cached empty slab to avoid thrashing
+
+    // Statistics
+    size_t allocs;
+    size_t frees;
+    size_t failures;
+    size_t peak_objects;
+};
+
+// Heap range. The first heap_pages pages belong to the allocator; frames
+// are only mapped behind pages that are in use or recently freed.
+static uint8_t* const heap_base = (uint8_t*)KHEAP_START;
+static size_t heap_pages = 0;
+static size_t mapped_pages = 0;
+static PageDesc page_desc[KHEAP_MAX_PAGES];
+static PageDesc* free_bins[FREE_BINS];
+#if CONFIG_HEAP_NEXT_FIT
+static PageDesc* rover = NULL;
+#endif
+
+// Built-in caches
+static kmem_cache_t cache_cache;
+static kmem_cache_t kmalloc_caches[KMALLOC_CLASSES];
+static const char* kmalloc_cache_names[KMALLOC_CLASSES] = {
+    "kmalloc-16", "kmalloc-32", "kmalloc-64", "kmalloc-128",
+    "kmalloc-256", "kmalloc-512", "kmalloc-1024", "kmalloc-2048"
+};
+
+// Counters for allocations served in whole pages
+static KmallocStats large_stats;
+
+#if CONFIG_MEMORY_DEBUG
+// Every kmalloc gets this many canary bytes after the requested size
+#define REDZONE_SIZE 8
+#define REDZONE_BYTE 0xCC
+
+#define TRACK_SLOTS CONFIG_MEMORY_DEBUG_SLOTS
+#define TRACK_MASK (TRACK_SLOTS - 1)
+#define CORRUPTION_LOG 8
+
+// Live allocation record. The table is open addressed with linear
+// probing and keyed by pointer; a zero ptr marks an empty slot.
+typedef struct {
+    uintptr_t ptr;
+    void* caller;
+    uint32_t seq;
+    uint32_t size;
+} TrackEntry;
+
+static TrackEntry track[TRACK_SLOTS];
+static size_t track_count = 0;
+static size_t untracked = 0;
+static uint32_t alloc_seq = 0;
+
+static KmallocCorruption corruption_log[CORRUPTION_LOG];
+static size_t corruption_count = 0;
+
+static inline size_t track_hash(uintptr_t ptr) {
+    uint32_t h = (uint32_t)(ptr >> 3) * 2654435761u;
+    return (h ^ (h >> 16)) & TRACK_MASK;
+}
+
+// Record a new allocation and arm its red zone
+static void track_insert(void* ptr, size_t size, void* caller) {
+    memset((uint8_t*)ptr + size, REDZONE_BYTE, REDZONE_SIZE);
+    uint32_t seq = alloc_seq++;
+
+    // Keep one slot empty so that lookups always terminate
+    if (track_count >= TRACK_SLOTS - 1) {
+        untracked++;
+        return;
+    }
+
+    size_t slot = track_hash((uintptr_t)ptr);
+    while (track[slot].ptr) {
+        slot = (slot + 1) & TRACK_MASK;
+    }
+    track[slot].ptr = (uintptr_t)ptr;
+    track[slot].caller = caller;
+    track[slot].seq = seq;
+    track[slot].size = size;
+    track_count++;
+}
+
+// Drop the record at slot, shifting later entries of the probe chain back
+static void track_delete(size_t slot) {
+    size_t hole = slot;
+    size_t next = (hole + 1) & TRACK_MASK;
+
+    while (track[next].ptr) {
+        size_t home = track_hash(track[next].ptr);
+        if (((next - home) & TRACK_MASK) >= ((next - hole) & TRACK_MASK)) {
+            track[hole] = track[next];
+            hole = next;
+        }
+        next = (next + 1) & TRACK_MASK;
+    }
+    track[hole].ptr = 0;
+    track_count--;
+}
+
+// Slot holding ptr's record, or an empty slot if it has none
+static size_t track_find(const void* ptr) {
+    size_t slot = track_hash((uintptr_t)ptr);
+    while (track[slot].ptr && track[slot].ptr != (uintptr_t)ptr) {
+        slot = (slot + 1) & TRACK_MASK;
+    }
+    return slot;
+}
+
+// Record a new size for a block resized in place and move its red zone
+static void track_resize(void* ptr, size_t size) {
+    size_t slot = track_find(ptr);
+    if (!track[slot].ptr) return;
+
+    track[slot].size = size;
+    memset((uint8_t*)ptr + size, REDZONE_BYTE, REDZONE_SIZE);
+}
+
+// Check the red zone of an allocation being freed and forget it
+static void track_remove(void* ptr) {
+    size_t slot = track_find(ptr);
+    if (!track[slot].ptr) {
+        if (untracked) untracked--;
+        return;
+    }
+
+    const uint8_t* zone = (const uint8_t*)ptr + track[slot].size;
+    for (size_t i = 0; i < REDZONE_SIZE; i++) {
+        if (zone[i] != REDZONE_BYTE) {
+            KmallocCorruption* entry = &corruption_log[corruption_count++ % CORRUPTION_LOG];
+            entry->ptr = ptr;
+            entry->caller = track[slot].caller;
+            entry->seq = track[slot].seq;
+            entry->size = track[slot].size;
+            break;
+        }
+    }
+
+    track_delete(slot);
+}
+#else
+#define REDZONE_SIZE 0
+#endif
+
+static inline size_t page_index(const void* addr) {
+    return ((const uint8_t*)addr - heap_base) / PAGE_SIZE;
+}
+
+static inline void* page_address(const PageDesc* desc) {
+    return heap_base + (size_t)(desc - page_desc) * PAGE_SIZE;
+}
+
+static inline bool in_heap(const void* addr) {
+    return (const uint8_t*)addr >= heap_base &&
+           (const uint8_t*)addr < heap_base + heap_pages * PAGE_SIZE;
+}
+
+// Map a request size to its kmalloc size class
+static inline size_t size_class(size_t size) {
+    if (size <= (1 << KMALLOC_MIN_SHIFT)) return 0;
+    return (32 - __builtin_clz((uint32_t)(size - 1))) - KMALLOC_MIN_SHIFT;
+}
+
+// Free-list bin for a run of the given length
+static inline size_t run_bin(size_t pages) {
+#if CONFIG_HEAP_NEXT_FIT
+    (void)pages;
+    return 0;
+#else
+    size_t bin = 31 - __builtin_clz((uint32_t)pages);
+    return bin < FREE_BINS ? bin : FREE_BINS - 1;
+#endif
+}
+
+// Tag a run as free and put it on its bin's free list
+static void free_run_insert(PageDesc* run, size_t pages, size_t backed) {
+    PageDesc* tail = run + pages - 1;
+    run->type = PAGE_TYPE_FREE;
+    run->pages = pages;
+    run->backed = backed;
+    tail->type = PAGE_TYPE_FREE;
+    tail->pages = pages;
+
+    PageDesc** head = &free_bins[run_bin(pages)];
+    run->prev = NULL;
+    run->next = *head;
+    if (*head) {
+        (*head)->prev = run;
+    }
+    *head = run;
+}
+
+// Unlink a free run from its bin
+static void free_run_remove(PageDesc* run) {
+#if CONFIG_HEAP_NEXT_FIT
+    if (rover == run) {
+        rover = run->next;
+    }
+#endif
+    if (run->prev) {
+        run->prev->next = run->next;
+    } else {
+        free_bins[run_bin(run->pages)] = run->next;
+    }
+    if (run->next) {
+        run->next->prev = run->prev;
+    }
+}
+
+// Find a free run of at least the given length
+static PageDesc* find_free_run(size_t pages) {
+#if CONFIG_HEAP_NEXT_FIT
+    // Resume from where the last search stopped, wrapping once
+    PageDesc* current = rover ? rover : free_bins[0];
+    for (int pass = 0; pass < 2; pass++) {
+        while (current) {
+            if (current->pages >= pages) {
+                return current;
+            }
+            current = current->next;
+        }
+        current = free_bins[0];
+    }
+    return NULL;
+#else
+    // Runs in the first bin may be too short; every later bin fits
+    for (PageDesc* current = free_bins[run_bin(pages)]; current; current = current->next) {
+        if (current->pages >= pages) {
+            return current;
+        }
+    }
+    for (size_t bin = run_bin(pages) + 1; bin < FREE_BINS; bin++) {
+        if (free_bins[bin]) {
+            return free_bins[bin];
+        }
+    }
+    return NULL;
+#endif
+}
+
+// Number of pages in a run with a frame behind them
+static size_t count_backed(const PageDesc* run, size_t pages) {
+    size_t backed = 0;
+    for (size_t i = 0; i < pages; i++) {
+        backed += run[i].mapped;
+    }
+    return backed;
+}
+
+// Map a fresh frame behind every page of a run that lacks one. Frames
+// may hold another subsystem's data, so they are zeroed on the way in;
+// that also lets kcalloc skip them.
+static bool back_pages(PageDesc* run, size_t pages) {
+    for (size_t i = 0; i < pages; i++) {
+        if (run[i].mapped) continue;
+
+        uintptr_t frame = alloc_page();
+        if (!frame) return false;
+        if (!vmm_map((uintptr_t)page_address(&run[i]), frame, PAGE_WRITE)) {
+            free_page(frame);
+            return false;
+        }
+        memset(page_address(&run[i]), 0, PAGE_SIZE);
+        run[i].mapped = true;
+        run[i].clean = true;
+        mapped_pages++;
+    }
+    return true;
+}
+
+// Unmap every page of a run and give the frames back
+static void unback_pages(PageDesc* run, size_t pages) {
+    for (size_t i = 0; i < pages; i++) {
+        if (!run[i].mapped) continue;
+
+        uintptr_t frame = vmm_unmap((uintptr_t)page_address(&run[i]));
+        if (frame) {
+            free_page(frame);
+        }
+        run[i].mapped = false;
+        run[i].clean = false;
+        mapped_pages--;
+    }
+    tlb_flush_range((uintptr_t)page_address(run), pages);
+}
+
+// Point the pages of a run at the run's first page (NULL when free)
+static void set_run_head(PageDesc* run, size_t pages, PageDesc* head) {
+    for (size_t i = 0; i < pages; i++) {
+        run[i].head = head;
+    }
+}
+
+// Put a run of pages on the free lists, merging with free neighbours.
+// Once a free run holds CONFIG_KHEAP_TRIM_PAGES mapped pages, its frames
+// go back to the page allocator.
+static void release_run(PageDesc* block, size_t backed) {
+    size_t pages = block->pages;
+    set_run_head(block, pages, NULL);
+
+    // The following run starts right after our last page
+    PageDesc* next = block + pages;
+    if (next < page_desc + heap_pages && next->type == PAGE_TYPE_FREE) {
+        free_run_remove(next);
+        pages += next->pages;
+        backed += next->backed;
+    }
+
+    // The preceding run's tail tag tells us where it starts
+    if (block > page_desc && block[-1].type == PAGE_TYPE_FREE) {
+        PageDesc* prev = block - block[-1].pages;
+        free_run_remove(prev);
+        pages += prev->pages;
+        backed += prev->backed;
+        block = prev;
+    }
+
+    if (backed >= CONFIG_KHEAP_TRIM_PAGES) {
+        unback_pages(block, pages);
+        backed = 0;
+    }
+
+    free_run_insert(block, pages, backed);
+}
+
+// Extend the heap's virtual range so that a run of the given length
+// fits, by at least CONFIG_KHEAP_GROW_PAGES at a time. Frames are mapped
+// in when the pages are handed out.
+static bool heap_grow(size_t pages) {
+    // A free run at the top of the heap counts towards the request
+    if (heap_pages > 0 && page_desc[heap_pages - 1].type == PAGE_TYPE_FREE) {
+        size_t top = page_desc[heap_pages - 1].pages;
+        pages = pages > top ? pages - top : 0;
+    }
+    if (pages < CONFIG_KHEAP_GROW_PAGES) {
+        pages = CONFIG_KHEAP_GROW_PAGES;
+    }
+    if (pages > KHEAP_MAX_PAGES - heap_pages) {
+        pages = KHEAP_MAX_PAGES - heap_pages;
+    }
+    if (pages == 0) return false;
+
+    PageDesc* block = &page_desc[heap_pages];
+    heap_pages += pages;
+    block->pages = pages;
+    release_run(block, 0);
+    return true;
+}
+
+// Take a free run off its bin, keeping only its first pages and putting
+// the remainder back as a free run of its own
+static void take_free_run(PageDesc* run, size_t pages) {
+    free_run_remove(run);
+
+    if (run->pages > pages) {
+        PageDesc* rest = run + pages;
+        free_run_insert(rest, run->pages - pages, run->backed - count_backed(run, pages));
+#if CONFIG_HEAP_NEXT_FIT
+        rover = rest;
+#endif
+    }
+    run->pages = pages;
+}
+
+// Tag the first and last page of an allocated run, and point every page
+// of a large run at its first
+static void set_run_tags(PageDesc* run, size_t pages, uint8_t type) {
+    PageDesc* tail = run + pages - 1;
+    run->type = type;
+    run->pages = pages;
+    tail->type = type;
+    tail->pages = pages;
+    if (type == PAGE_TYPE_LARGE) {
+        set_run_head(run, pages, run);
+    }
+}
+
+// Hand a run's pages to a caller, zeroing the ones that may be dirty if
+// asked to. Unmapped pages are zero-filled when they are first touched.
+static void claim_pages(PageDesc* run, size_t pages, bool zero) {
+    for (size_t i = 0; i < pages; i++) {
+        if (zero && run[i].mapped && !run[i].clean) {
+            memset(page_address(&run[i]), 0, PAGE_SIZE);
+        }
+        run[i].clean = false;
+    }
+}
+
+// Allocate a run of contiguous pages from the heap, growing it if needed.
+// Slab pages are backed right away; large runs get their frames on first
+// touch through heap_fault.
+static void* alloc_pages_run(size_t pages, uint8_t type, bool zero) {
+    PageDesc* run = find_free_run(pages);
+    if (!run) {
+        if (!heap_grow(pages)) return NULL; // Out of memory
+        run = find_free_run(pages);
+        if (!run) return NULL;
+    }
+
+    take_free_run(run, pages);
+
+    if (type != PAGE_TYPE_LARGE && !back_pages(run, pages)) {
+        release_run(run, count_backed(run, pages));
+        return NULL; // Out of memory
+    }
+
+    claim_pages(run, pages, zero);
+    set_run_tags(run, pages, type);
+    return page_address(run);
+}
+
+// Resize an allocated run in place, either by handing its tail back or
+// by taking over the free run that follows it
+static bool resize_pages_run(PageDesc* run, size_t pages) {
+    size_t old_pages = run->pages;
+
+    if (pages < old_pages) {
+        PageDesc* rest = run + pages;
+        set_run_tags(run, pages, run->type);
+        rest->pages = old_pages - pages;
+        release_run(rest, count_backed(rest, rest->pages));
+        return true;
+    }
+
+    size_t extra = pages - old_pages;
+    PageDesc* next = run + old_pages;
+
+    // At the top of the heap the range can simply be extended first
+    PageDesc* heap_end = page_desc + heap_pages;
+    if (next == heap_end ||
+        (next->type == PAGE_TYPE_FREE && next + next->pages == heap_end && next->pages < extra)) {
+        if (!heap_grow(extra)) return false;
+    }
+
+    if (next->type != PAGE_TYPE_FREE || next->pages < extra) return false;
+
+    // The new tail is backed on first touch, like the rest of the run
+    take_free_run(next, extra);
+    claim_pages(next, extra, false);
+    set_run_tags(run, pages, run->type);
+    return true;
+}
+
+// Return a run of pages to the heap
+static void free_pages_run(void* addr) {
+    PageDesc* block = &page_desc[page_index(addr)];
+    release_run(block, count_backed(block, block->pages));
+}
+
+// Page-fault handler for the heap range: back the first touch of a page
+// in an allocated run. Touching a free page is a use-after-free, and is
+// left to the fault report.
+static bool heap_fault(uintptr_t addr) {
+    if (!in_heap((const void*)addr)) return false;
+
+    PageDesc* desc = &page_desc[page_index((const void*)addr)];
+    if (desc->mapped) return false;
+
+    // Only large runs are backed lazily; slab pages are mapped up front
+    if (!desc->head) return false;
+
+    if (!back_pages(desc, 1)) return false;
+    desc->clean = false;
+    return true;
+}
+
+// Set up an empty cache
+static void cache_init(kmem_cache_t* cache, const char* name, size_t size, size_t align) {
+    if (size < sizeof(void*)) size = sizeof(void*);
+    if (align < sizeof(void*)) align = sizeof(void*);
+    size = (size + align - 1) & ~(align - 1);
+
+    cache->name = name;
+    cache->object_size = size;
+    cache->first_offset = (sizeof(Slab) + align - 1) & ~(align - 1);
+    cache->slab_pages = (cache->first_offset + SLAB_MIN_OBJECTS * size + PAGE_SIZE - 1) / PAGE_SIZE;
+    cache->objects_per_slab = (cache->slab_pages * PAGE_SIZE - cache->first_offset) / size;
+    cache->partial = NULL;
+    cache->full = NULL;
+    cache->empty = NULL;
+    cache->allocs = 0;
+    cache->frees = 0;
+    cache->failures = 0;
+    cache->peak_objects = 0;
+}
+
+static void slab_list_remove(Slab** list, Slab* slab) {
+    if (slab->prev) {
+        slab->prev->next = slab->next;
+    } else {
+        *list = slab->next;
+    }
+    if (slab->next) {
+        slab->next->prev = slab->prev;
+    }
+    slab->prev = NULL;
+    slab->next = NULL;
+}
+
+static void slab_list_push(Slab** list, Slab* slab) {
+    slab->prev = NULL;
+    slab->next = *list;
+    if (*list) {
+        (*list)->prev = slab;
+    }
+    *list = slab;
+}
+
+// Carve a new slab out of the pool and thread its free list
+static Slab* slab_create(kmem_cache_t* cache) {
+    uint8_t* base = alloc_pages_run(cache->slab_pages, PAGE_TYPE_SLAB, false);
+    if (!base) return NULL;
+
+    Slab* slab = (Slab*)base;
+    PageDesc* desc = &page_desc[page_index(base)];
+    for (size_t i = 0; i < cache->slab_pages; i++) {
+        desc[i].type = PAGE_TYPE_SLAB;
+        desc[i].slab = slab;
+    }
+
+    slab->cache = cache;
+    slab->prev = NULL;
+    slab->next = NULL;
+    slab->inuse = 0;
+    slab->free_objects = NULL;
+
+    uint8_t* obj = base + cache->first_offset + (cache->objects_per_slab - 1) * cache->object_size;
+    for (uint16_t i = 0; i < cache->objects_per_slab; i++) {
+        *(void**)obj = slab->free_objects;
+        slab->free_objects = obj;
+        obj -= cache->object_size;
+    }
+
+    return slab;
+}
+
+static void slab_destroy(Slab* slab) {
+    free_pages_run(slab);
+}
 
 // Initialize memory management
 void memory_init(void) {
-    // Initialize the first block to cover the entire pool
-    free_list = (MemoryBlock*)memory_pool;
-    free_list->size = sizeof(memory_pool) - sizeof(MemoryBlock);
-    free_list->used = false;
-    free_list->next = NULL;
+    // The heap starts out empty and is mapped in as it grows
+    memset(page_desc, 0, sizeof(page_desc));
+    memset(free_bins, 0, sizeof(free_bins));
+    heap_pages = 0;
+    memset(&large_stats, 0, sizeof(large_stats));
+    large_stats.name = "kmalloc-large";
+#if CONFIG_MEMORY_DEBUG
+    memset(track, 0, sizeof(track));
+    track_count = 0;
+    untracked = 0;
+    alloc_seq = 0;
+    corruption_count = 0;
+#endif
+
+    // Large runs are backed on demand by heap_fault
+    vmm_reserve(KHEAP_START, (size_t)KHEAP_MAX_PAGES * PAGE_SIZE, PAGE_WRITE, heap_fault);
+
+    // Bootstrap the cache of caches and the kmalloc size classes
+    cache_init(&cache_cache, "kmem_cache", sizeof(kmem_cache_t), KMALLOC_ALIGN);
+    for (size_t i = 0; i < KMALLOC_CLASSES; i++) {
+        cache_init(&kmalloc_caches[i], kmalloc_cache_names[i],
+                   (size_t)1 << (i + KMALLOC_MIN_SHIFT), KMALLOC_ALIGN);
+    }
 }
 
-// Allocate memory
-void* kmalloc(size_t size) {
+// Create a cache of fixed-size objects
+kmem_cache_t* kmem_cache_create(const char* name, size_t size, size_t align) {
     if (size == 0) return NULL;
-    
-    // Add alignment padding
-    size = (size + 7) & ~7;
-    
-    MemoryBlock* current = free_list;
-    while (current) {
-        if (!current->used && current->size >= size) {
-            // Split block if it's large enough
-            if (current->size >= size + sizeof(MemoryBlock) + 8) {
-                MemoryBlock* new_block = (MemoryBlock*)((uint8_t*)current + sizeof(MemoryBlock) + size);
-                new_block->size = current->size - size - sizeof(MemoryBlock);
-                new_block->used = false;
-                new_block->next = current->next;
-                
-                current->size = size;
-                current->next = new_block;
+    if (align & (align - 1)) return NULL;
+
+    kmem_cache_t* cache = kmem_cache_alloc(&cache_cache);
+    if (!cache) return NULL;
+
+    cache_init(cache, name, size, align ? align : KMALLOC_ALIGN);
+    return cache;
+}
+
+// Destroy a cache and release all of its slabs
+void kmem_cache_destroy(kmem_cache_t* cache) {
+    if (!cache) return;
+
+    Slab** lists[] = { &cache->partial, &cache->full, &cache->empty };
+    for (size_t i = 0; i < sizeof(lists) / sizeof(lists[0]); i++) {
+        while (*lists[i]) {
+            Slab* slab = *lists[i];
+            *lists[i] = slab->next;
+            slab_destroy(slab);
+        }
+    }
+
+    kmem_cache_free(&cache_cache, cache);
+}
+
+// Allocate an object from a cache
+void* kmem_cache_alloc(kmem_cache_t* cache) {
+    Slab* slab = cache->partial;
+    if (!slab) {
+        if (cache->empty) {
+            slab = cache->empty;
+            cache->empty = NULL;
+        } else {
+            slab = slab_create(cache);
+            if (!slab) {
+                cache->failures++;
+                return NULL; // Out of memory
             }
-            
-            current->used = true;
-            return (void*)((uint8_t*)current + sizeof(MemoryBlock));
         }
-        current = current->next;
+        slab_list_push(&cache->partial, slab);
+    }
+
+    void* obj = slab->free_objects;
+    slab->free_objects = *(void**)obj;
+    slab->inuse++;
+
+    cache->allocs++;
+    if (cache->allocs - cache->frees > cache->peak_objects) {
+        cache->peak_objects = cache->allocs - cache->frees;
+    }
+
+    if (!slab->free_objects) {
+        slab_list_remove(&cache->partial, slab);
+        slab_list_push(&cache->full, slab);
+    }
+
+    return obj;
+}
+
+// Return an object to its cache
+void kmem_cache_free(kmem_cache_t* cache, void* obj) {
+    if (!obj) return;
+
+    Slab* slab = page_desc[page_index(obj)].slab;
+    bool was_full = slab->free_objects == NULL;
+
+    *(void**)obj = slab->free_objects;
+    slab->free_objects = obj;
+    slab->inuse--;
+    cache->frees++;
+
+    if (was_full) {
+        slab_list_remove(&cache->full, slab);
+        slab_list_push(&cache->partial, slab);
+    }
+
+    // Keep one empty slab around, give the rest back to the pool
+    if (slab->inuse == 0) {
+        slab_list_remove(&cache->partial, slab);
+        if (!cache->empty) {
+            cache->empty = slab;
+        } else {
+            slab_destroy(slab);
+        }
     }
-    
-    return NULL; // Out of memory
+}
+
+// Allocate from a size class or in whole pages
+static void* kmalloc_raw(size_t size, bool zero) {
+    if (size <= KMALLOC_MAX_SIZE) {
+        void* obj = kmem_cache_alloc(&kmalloc_caches[size_class(size)]);
+        if (obj && zero) {
+            memset(obj, 0, size);
+        }
+        return obj;
+    }
+
+    // Large objects are served in whole pages
+    if (size > KHEAP_MAX_SIZE) {
+        large_stats.failures++;
+        return NULL;
+    }
+    size_t pages = (size + PAGE_SIZE - 1) / PAGE_SIZE;
+    void* ptr = alloc_pages_run(pages, PAGE_TYPE_LARGE, zero);
+    if (!ptr) {
+        large_stats.failures++;
+        return NULL;
+    }
+
+    large_stats.allocs++;
+    large_stats.live_bytes += pages * PAGE_SIZE;
+    if (large_stats.live_bytes > large_stats.peak_bytes) {
+        large_stats.peak_bytes = large_stats.live_bytes;
+    }
+    return ptr;
+}
+
+// Allocate on behalf of caller, which debug builds record
+static void* kmalloc_from(size_t size, bool zero, void* caller) {
+    // Checked before the red zone is added, which could wrap
+    if (size == 0 || size > KHEAP_MAX_SIZE - REDZONE_SIZE) return NULL;
+
+    void* ptr = kmalloc_raw(size + REDZONE_SIZE, zero);
+#if CONFIG_MEMORY_DEBUG
+    if (ptr) {
+        track_insert(ptr, size, caller);
+    }
+#else
+    (void)caller;
+#endif
+    return ptr;
+}
+
+// Bytes an allocation can hold, red zone included
+static size_t alloc_capacity(const PageDesc* desc) {
+    if (desc->type == PAGE_TYPE_SLAB) {
+        return desc->slab->cache->object_size;
+    }
+    return desc->pages * PAGE_SIZE;
+}
+
+// Try to make an allocation hold need bytes without moving it
+static bool resize_in_place(PageDesc* desc, size_t need) {
+    // Objects stay in place as long as they stay in their size class
+    if (desc->type == PAGE_TYPE_SLAB) {
+        return need <= KMALLOC_MAX_SIZE &&
+               desc->slab->cache == &kmalloc_caches[size_class(need)];
+    }
+
+    // Page runs shrink or grow into a free neighbour; anything that now
+    // fits a size class moves there instead
+    if (need <= KMALLOC_MAX_SIZE || need > KHEAP_MAX_SIZE) return false;
+
+    size_t old_pages = desc->pages;
+    size_t pages = (need + PAGE_SIZE - 1) / PAGE_SIZE;
+    if (pages == old_pages) return true;
+    if (!resize_pages_run(desc, pages)) return false;
+
+    large_stats.live_bytes = large_stats.live_bytes - old_pages * PAGE_SIZE + pages * PAGE_SIZE;
+    if (large_stats.live_bytes > large_stats.peak_bytes) {
+        large_stats.peak_bytes = large_stats.live_bytes;
+    }
+    return true;
+}
+
+// Allocate memory
+void* kmalloc(size_t size) {
+    return kmalloc_from(size, false, __builtin_return_address(0));
+}
+
+// Allocate zeroed memory for an array
+void* kcalloc(size_t count, size_t size) {
+    if (size && count > SIZE_MAX / size) return NULL;
+    return kmalloc_from(count * size, true, __builtin_return_address(0));
+}
+
+// Resize an allocation, in place when possible
+void* krealloc(void* ptr, size_t size) {
+    if (!ptr) {
+        return kmalloc_from(size, false, __builtin_return_address(0));
+    }
+    if (size == 0) {
+        kfree(ptr);
+        return NULL;
+    }
+    if (!in_heap(ptr)) return NULL;
+
+    // Too big for the heap; the block stays as it is
+    if (size > KHEAP_MAX_SIZE - REDZONE_SIZE) return NULL;
+
+    PageDesc* desc = &page_desc[page_index(ptr)];
+    if (desc->type != PAGE_TYPE_SLAB && desc->type != PAGE_TYPE_LARGE) return NULL;
+
+    if (resize_in_place(desc, size + REDZONE_SIZE)) {
+#if CONFIG_MEMORY_DEBUG
+        track_resize(ptr, size);
+#endif
+        return ptr;
+    }
+
+    void* new_ptr = kmalloc_from(size, false, __builtin_return_address(0));
+    if (!new_ptr) return NULL;
+
+    size_t old_size = ksize(ptr);
+    memcpy(new_ptr, ptr, old_size < size ? old_size : size);
+    kfree(ptr);
+    return new_ptr;
+}
+
+// Usable size of an allocation
+size_t ksize(const void* ptr) {
+    if (!ptr || !in_heap(ptr)) return 0;
+
+    const PageDesc* desc = &page_desc[page_index(ptr)];
+    if (desc->type != PAGE_TYPE_SLAB && desc->type != PAGE_TYPE_LARGE) return 0;
+
+#if CONFIG_MEMORY_DEBUG
+    size_t slot = track_find(ptr);
+    if (track[slot].ptr) {
+        return track[slot].size;
+    }
+#endif
+    return alloc_capacity(desc) - REDZONE_SIZE;
+}
+
+// Bytes currently mapped into the kernel heap
+size_t kheap_size(void) {
+    return mapped_pages * PAGE_SIZE;
 }
 
 // Free memory
 void kfree(void* ptr) {
-    if (!ptr) return;
-    
-    MemoryBlock* block = (MemoryBlock*)((uint8_t*)ptr - sizeof(MemoryBlock));
-    block->used = false;
-    
-    // Merge adjacent free blocks
-    MemoryBlock* current = free_list;
-    while (current) {
-        if (!current->used && current->next && !current->next->used) {
-            current->size += sizeof(MemoryBlock) + current->next->size;
-            current->next = current->next->next;
-        }
-        current = current->next;
-    }
-} 
\ No newline at end of file
+    if (!ptr || !in_heap(ptr)) return;
+
+    PageDesc* desc = &page_desc[page_index(ptr)];
+#if CONFIG_MEMORY_DEBUG
+    if (desc->type == PAGE_TYPE_SLAB || desc->type == PAGE_TYPE_LARGE) {
+        track_remove(ptr);
+    }
+#endif
+    if (desc->type == PAGE_TYPE_SLAB) {
+        kmem_cache_free(desc->slab->cache, ptr);
+    } else if (desc->type == PAGE_TYPE_LARGE) {
+        large_stats.frees++;
+        large_stats.live_bytes -= desc->pages * PAGE_SIZE;
+        free_pages_run(ptr);
+    }
+}
+
+// Snapshot the counters of one cache
+static void cache_stats(const kmem_cache_t* cache, KmallocStats* stats) {
+    stats->name = cache->name;
+    stats->object_size = cache->object_size;
+    stats->allocs = cache->allocs;
+    stats->frees = cache->frees;
+    stats->failures = cache->failures;
+    stats->live_bytes = (cache->allocs - cache->frees) * cache->object_size;
+    stats->peak_bytes = cache->peak_objects * cache->object_size;
+}
+
+// Collect allocation counters and summarize the free runs
+void kheap_get_stats(KheapStats* stats) {
+    memset(stats, 0, sizeof(*stats));
+
+    for (size_t i = 0; i < KMALLOC_CLASSES; i++) {
+        cache_stats(&kmalloc_caches[i], &stats->classes[i]);
+    }
+    stats->classes[KMALLOC_CLASSES] = large_stats;
+
+    stats->heap_pages = heap_pages;
+    stats->mapped_pages = mapped_pages;
+
+    for (size_t bin = 0; bin < FREE_BINS; bin++) {
+        for (const PageDesc* run = free_bins[bin]; run; run = run->next) {
+            size_t bucket = 31 - __builtin_clz((uint32_t)run->pages);
+            if (bucket >= KHEAP_HISTOGRAM_BUCKETS) {
+                bucket = KHEAP_HISTOGRAM_BUCKETS - 1;
+            }
+            stats->free_histogram[bucket]++;
+            stats->free_runs++;
+            stats->free_pages += run->pages;
+            stats->free_mapped_pages += run->backed;
+            if (run->pages > stats->largest_free_run) {
+                stats->largest_free_run = run->pages;
+            }
+        }
+    }
+
+    // Share of free space that a single request could not use at once
+    if (stats->free_pages) {
+        stats->fragmentation = 100 - (unsigned int)(stats->largest_free_run * 100 / stats->free_pages);
+    }
+}
+
+#if CONFIG_MEMORY_DEBUG
+// Group live allocations by call site
+size_t kmalloc_sites(KmallocSite* sites, size_t max) {
+    size_t count = 0;
+
+    for (size_t slot = 0; slot < TRACK_SLOTS; slot++) {
+        const TrackEntry* entry = &track[slot];
+        if (!entry->ptr) continue;
+
+        size_t i = 0;
+        while (i < count && sites[i].caller != entry->caller) {
+            i++;
+        }
+        if (i == count) {
+            if (count == max) continue;
+            sites[i].caller = entry->caller;
+            sites[i].count = 0;
+            sites[i].bytes = 0;
+            sites[i].oldest = entry->seq;
+            count++;
+        }
+
+        sites[i].count++;
+        sites[i].bytes += entry->size;
+        if (entry->seq < sites[i].oldest) {
+            sites[i].oldest = entry->seq;
+        }
+    }
+
+    // Insertion sort, largest byte total first
+    for (size_t i = 1; i < count; i++) {
+        KmallocSite site = sites[i];
+        size_t j = i;
+        while (j > 0 && sites[j - 1].bytes < site.bytes) {
+            sites[j] = sites[j - 1];
+            j--;
+        }
+        sites[j] = site;
+    }
+
+    return count;
+}
+
+// Sequence number of the next allocation
+uint32_t kmalloc_sequence(void) {
+    return alloc_seq;
+}
+
+// Live allocations the tracking table had no room for
+size_t kmalloc_untracked(void) {
+    return untracked;
+}
+
+// Most recent red-zone hits, newest first
+size_t kmalloc_corruptions(KmallocCorruption* log, size_t max) {
+    size_t stored = corruption_count < CORRUPTION_LOG ? corruption_count : CORRUPTION_LOG;
+    for (size_t i = 0; i < stored && i < max; i++) {
+        log[i] = corruption_log[(corruption_count - 1 - i) % CORRUPTION_LOG];
+    }
+    return corruption_count;
+}
+#endif
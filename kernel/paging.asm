@@ -1,10 +0,0 @@
-[BITS 32]
-
-section .text
-align 4
-page_fault:
-    ; Simple page fault handler
-    cli
-    hlt
-    jmp page_fault
- 
\ No newline at end of file
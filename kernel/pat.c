@@ -0,0 +1,130 @@
+#include "include/pat.h"
+#include "include/cpu.h"
+#include "include/asm.h"
+#include "include/vmm.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+// Model-specific registers
+#define MSR_MTRR_CAP      0x0FE
+#define MSR_MTRR_PHYSBASE 0x200  // Slot n at 0x200 + 2n
+#define MSR_MTRR_PHYSMASK 0x201  // Slot n at 0x201 + 2n
+#define MSR_PAT           0x277
+#define MSR_MTRR_DEF_TYPE 0x2FF
+
+#define MTRR_CAP_VCNT       0xFF
+#define MTRR_CAP_WC         (1 << 10)
+#define MTRR_MASK_VALID     (1 << 11)
+#define MTRR_DEF_TYPE_ENABLE (1 << 11)
+
+#define CR0_NW (1u << 29)
+#define CR0_CD (1u << 30)
+
+// PAT entry n lives in bits 8n..8n+7. PA0-PA3 are the ones reachable with
+// PWT/PCD alone, which keeps the PAT bit (at different positions in 4 KB
+// and 4 MB entries) unused. PA1 becomes WC; the rest keep the reset values.
+#define PAT_ENTRY(n, type) ((uint64_t)(type) << ((n) * 8))
+#define PAT_VALUE (PAT_ENTRY(0, MEMTYPE_WB) | PAT_ENTRY(1, MEMTYPE_WC) | \
+                   PAT_ENTRY(2, MEMTYPE_UC_MINUS) | PAT_ENTRY(3, MEMTYPE_UC) | \
+                   PAT_ENTRY(4, MEMTYPE_WB) | PAT_ENTRY(5, MEMTYPE_WT) | \
+                   PAT_ENTRY(6, MEMTYPE_UC_MINUS) | PAT_ENTRY(7, MEMTYPE_UC))
+
+static bool pat_ready = false;
+
+// Program the page attribute table
+bool pat_init(void) {
+    if (!cpu_has_feature(CPU_FEATURE_PAT) || !cpu_has_feature(CPU_FEATURE_MSR)) {
+        return false;
+    }
+    wrmsr(MSR_PAT, PAT_VALUE);
+    pat_ready = true;
+    return true;
+}
+
+// Check whether the PAT was programmed
+bool pat_enabled(void) {
+    return pat_ready;
+}
+
+// Page entry bits selecting PA1
+uint32_t pat_write_combining_flags(void) {
+    return pat_ready ? PAGE_WRITE_THROUGH : 0;
+}
+
+// Mask of valid physical address bits
+static uint64_t phys_addr_mask(void) {
+    uint32_t eax, ebx, ecx, edx;
+    unsigned int bits = 36;
+
+    cpuid(0x80000000, &eax, &ebx, &ecx, &edx);
+    if (eax >= 0x80000008) {
+        cpuid(0x80000008, &eax, &ebx, &ecx, &edx);
+        bits = eax & 0xFF;
+    }
+    return (1ULL << bits) - 1;
+}
+
+// Enter the MTRR update sequence: caches off and flushed, MTRRs disabled
+static uint32_t mtrr_begin(void) {
+    uint32_t eflags = READ_EFLAGS();
+    CLI();
+
+    WRITE_CR0((READ_CR0() | CR0_CD) & ~CR0_NW);
+    WBINVD();
+    flush_tlb();
+
+    wrmsr(MSR_MTRR_DEF_TYPE, rdmsr(MSR_MTRR_DEF_TYPE) & ~(uint64_t)MTRR_DEF_TYPE_ENABLE);
+    return eflags;
+}
+
+// Leave the MTRR update sequence
+static void mtrr_end(uint32_t eflags) {
+    WBINVD();
+    flush_tlb();
+
+    wrmsr(MSR_MTRR_DEF_TYPE, rdmsr(MSR_MTRR_DEF_TYPE) | MTRR_DEF_TYPE_ENABLE);
+    WRITE_CR0(READ_CR0() & ~(CR0_CD | CR0_NW));
+    WRITE_EFLAGS(eflags);
+}
+
+// Claim a free variable-range MTRR for [base, base + size)
+int mtrr_add(uint64_t base, uint64_t size, uint8_t type) {
+    if (!cpu_has_feature(CPU_FEATURE_MTRR) || !cpu_has_feature(CPU_FEATURE_MSR)) {
+        return -1;
+    }
+    if (size == 0 || (size & (size - 1)) || (base & (size - 1))) {
+        return -1;
+    }
+
+    uint64_t cap = rdmsr(MSR_MTRR_CAP);
+    if (type == MEMTYPE_WC && !(cap & MTRR_CAP_WC)) {
+        return -1;
+    }
+
+    int slot = -1;
+    for (int i = 0; i < (int)(cap & MTRR_CAP_VCNT); i++) {
+        if (!(rdmsr(MSR_MTRR_PHYSMASK + 2 * i) & MTRR_MASK_VALID)) {
+            slot = i;
+            break;
+        }
+    }
+    if (slot < 0) return -1;
+
+    uint64_t mask = phys_addr_mask();
+    uint32_t eflags = mtrr_begin();
+    wrmsr(MSR_MTRR_PHYSBASE + 2 * slot, (base & mask & ~0xFFFULL) | type);
+    wrmsr(MSR_MTRR_PHYSMASK + 2 * slot, (~(size - 1) & mask & ~0xFFFULL) | MTRR_MASK_VALID);
+    mtrr_end(eflags);
+
+    return slot;
+}
+
+// Release a slot claimed by mtrr_add
+void mtrr_remove(int slot) {
+    if (slot < 0) return;
+
+    uint32_t eflags = mtrr_begin();
+    wrmsr(MSR_MTRR_PHYSMASK + 2 * slot, 0);
+    wrmsr(MSR_MTRR_PHYSBASE + 2 * slot, 0);
+    mtrr_end(eflags);
+}
@@ -58,4 +58,16 @@ void init_pic(void) {
 
     // Enable interrupts
     __asm__("sti");
-} 
\ No newline at end of file
+}
+
+// Let an IRQ line through to the CPU
+void pic_unmask(uint8_t irq) {
+    uint16_t port = PIC1_DATA;
+    if (irq >= 8) {
+        port = PIC2_DATA;
+        irq -= 8;
+        // The slave PIC reaches the CPU through IRQ2
+        port_out_byte(PIC1_DATA, port_in_byte(PIC1_DATA) & ~(1 << 2));
+    }
+    port_out_byte(port, port_in_byte(port) & ~(1 << irq));
+}
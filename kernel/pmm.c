@@ -0,0 +1,310 @@
+#include "include/pmm.h"
+#include "include/multiboot.h"
+#include "include/graphics.h"
+#include "include/klog.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#define PAGE_SIZE 4096
+#define PAGE_SHIFT 12
+
+// Frame states
+#define FRAME_RESERVED  0
+#define FRAME_FREE      1
+#define FRAME_ALLOCATED 2
+
+// End of free list
+#define FRAME_NONE 0xFFFFFFFF
+
+// Multiboot memory map entry type for usable RAM
+#define MMAP_TYPE_AVAILABLE 1
+
+// Most reserved ranges we track at boot
+#define MAX_RESERVED 16
+
+// Per-frame descriptor
+typedef struct {
+    uint32_t next;      // Next free block of the same order
+    uint32_t prev;      // Previous free block of the same order
+    uint8_t order;      // Order of the block this frame heads
+    uint8_t state;
+} PageFrame;
+
+// Multiboot module entry
+typedef struct {
+    uint32_t mod_start;
+    uint32_t mod_end;
+    uint32_t string;
+    uint32_t reserved;
+} MultibootModule;
+
+// Physical address range [base, limit)
+typedef struct {
+    uint64_t base;
+    uint64_t limit;
+} PhysRange;
+
+static PageFrame* frames = NULL;
+static uint32_t frame_count = 0;
+static uintptr_t frames_end = 0;
+static uint32_t free_head[PMM_MAX_ORDER + 1];
+static size_t free_count[PMM_MAX_ORDER + 1];
+static size_t usable_frames = 0;
+
+static PhysRange reserved[MAX_RESERVED];
+static int reserved_count = 0;
+
+static inline uint64_t page_align_up(uint64_t addr) {
+    return (addr + PAGE_SIZE - 1) & ~(uint64_t)(PAGE_SIZE - 1);
+}
+
+static void reserve_range(uint64_t base, uint64_t size) {
+    if (size == 0) return;
+    if (reserved_count >= MAX_RESERVED) {
+        // The range would be handed out as free RAM; say so at least
+        klog(KLOG_ERR, "pmm: reserved range table full, %#llx-%#llx not reserved",
+             (unsigned long long)base, (unsigned long long)(base + size));
+        return;
+    }
+    reserved[reserved_count].base = base & ~(uint64_t)(PAGE_SIZE - 1);
+    reserved[reserved_count].limit = page_align_up(base + size);
+    reserved_count++;
+}
+
+// Find the lowest reserved range overlapping [base, limit)
+static const PhysRange* find_reserved(uint64_t base, uint64_t limit) {
+    const PhysRange* lowest = NULL;
+    for (int i = 0; i < reserved_count; i++) {
+        if (base < reserved[i].limit && reserved[i].base < limit &&
+            (!lowest || reserved[i].base < lowest->base)) {
+            lowest = &reserved[i];
+        }
+    }
+    return lowest;
+}
+
+static void list_push(unsigned int order, uint32_t pfn) {
+    frames[pfn].order = order;
+    frames[pfn].state = FRAME_FREE;
+    frames[pfn].prev = FRAME_NONE;
+    frames[pfn].next = free_head[order];
+    if (free_head[order] != FRAME_NONE) {
+        frames[free_head[order]].prev = pfn;
+    }
+    free_head[order] = pfn;
+    free_count[order]++;
+}
+
+static void list_remove(unsigned int order, uint32_t pfn) {
+    if (frames[pfn].prev != FRAME_NONE) {
+        frames[frames[pfn].prev].next = frames[pfn].next;
+    } else {
+        free_head[order] = frames[pfn].next;
+    }
+    if (frames[pfn].next != FRAME_NONE) {
+        frames[frames[pfn].next].prev = frames[pfn].prev;
+    }
+    free_count[order]--;
+}
+
+// Free a block and merge it with its buddies as far as possible
+static void free_block(uint32_t pfn, unsigned int order) {
+    // If the block ends up merged into a lower buddy it heads nothing,
+    // and a second free of it must be refused
+    frames[pfn].state = FRAME_RESERVED;
+    while (order < PMM_MAX_ORDER) {
+        uint32_t buddy = pfn ^ (1u << order);
+        if (buddy >= frame_count ||
+            frames[buddy].state != FRAME_FREE ||
+            frames[buddy].order != order) {
+            break;
+        }
+        list_remove(order, buddy);
+        frames[buddy].state = FRAME_RESERVED;
+        pfn &= ~(1u << order);
+        order++;
+    }
+    list_push(order, pfn);
+}
+
+// Hand [first, last) to the allocator in the largest aligned blocks that fit
+static void free_frame_range(uint32_t first, uint32_t last) {
+    while (first < last) {
+        unsigned int order = 0;
+        while (order < PMM_MAX_ORDER &&
+               (first & ((2u << order) - 1)) == 0 &&
+               first + (2u << order) <= last) {
+            order++;
+        }
+        free_block(first, order);
+        usable_frames += 1u << order;
+        first += 1u << order;
+    }
+}
+
+// Release a usable region, skipping over reserved ranges
+static void add_region(uint64_t base, uint64_t limit) {
+    base = page_align_up(base);
+    limit &= ~(uint64_t)(PAGE_SIZE - 1);
+
+    while (base < limit) {
+        const PhysRange* r = find_reserved(base, limit);
+        uint64_t stop = r ? (r->base > base ? r->base : base) : limit;
+        if (stop > base) {
+            free_frame_range(base >> PAGE_SHIFT, stop >> PAGE_SHIFT);
+        }
+        if (!r) break;
+        base = r->limit;
+    }
+}
+
+// Place the frame array in the first usable gap large enough to hold it
+static uintptr_t place_frame_array(struct memory_map_entry* mmap, uintptr_t mmap_end, uint64_t size) {
+    for (struct memory_map_entry* e = mmap; (uintptr_t)e < mmap_end;
+         e = (struct memory_map_entry*)((uintptr_t)e + e->size + sizeof(e->size))) {
+        if (e->type != MMAP_TYPE_AVAILABLE) continue;
+
+        uint64_t limit = e->base_addr + e->length;
+        if (limit > 0x100000000ULL) limit = 0x100000000ULL;
+
+        uint64_t base = page_align_up(e->base_addr);
+        while (base + size <= limit) {
+            const PhysRange* r = find_reserved(base, base + size);
+            if (!r) return (uintptr_t)base;
+            base = r->limit;
+        }
+    }
+    return 0;
+}
+
+// Initialize the physical memory manager from the multiboot memory map
+void pmm_init(MultibootInfo* info) {
+    for (int i = 0; i <= PMM_MAX_ORDER; i++) {
+        free_head[i] = FRAME_NONE;
+        free_count[i] = 0;
+    }
+
+    if (!(info->flags & MULTIBOOT_FLAG_MMAP)) return;
+
+    struct memory_map_entry* mmap = (struct memory_map_entry*)(uintptr_t)info->mmap_addr;
+    uintptr_t mmap_end = (uintptr_t)info->mmap_addr + info->mmap_length;
+
+    // Real-mode IVT, BIOS data and the legacy video/ROM hole
+    reserve_range(0, 0x100000);
+
+    // Kernel image
+    reserve_range((uintptr_t)&start, (uintptr_t)&end - (uintptr_t)&start);
+
+    // Multiboot structures
+    reserve_range((uintptr_t)info, sizeof(MultibootInfo));
+    reserve_range(info->mmap_addr, info->mmap_length);
+    if (info->flags & MULTIBOOT_FLAG_CMDLINE) {
+        reserve_range(info->cmdline, PAGE_SIZE);
+    }
+    if (info->flags & MULTIBOOT_FLAG_MODS && info->mods_count) {
+        MultibootModule* mods = (MultibootModule*)(uintptr_t)info->mods_addr;
+        reserve_range(info->mods_addr, info->mods_count * sizeof(MultibootModule));
+
+        // One range spanning every module, so any number of them fits
+        // the table. The loader packs them together, so little is lost.
+        uint32_t low = mods[0].mod_start;
+        uint32_t high = mods[0].mod_end;
+        for (uint32_t i = 1; i < info->mods_count; i++) {
+            if (mods[i].mod_start < low) low = mods[i].mod_start;
+            if (mods[i].mod_end > high) high = mods[i].mod_end;
+        }
+        reserve_range(low, high - low);
+    }
+
+    // Linear framebuffer
+    reserve_range(GRAPHICS_LFB_ADDRESS, GRAPHICS_LFB_SIZE);
+
+    // Size the frame array by the highest usable address below 4 GB
+    uint64_t top = 0;
+    for (struct memory_map_entry* e = mmap; (uintptr_t)e < mmap_end;
+         e = (struct memory_map_entry*)((uintptr_t)e + e->size + sizeof(e->size))) {
+        if (e->type == MMAP_TYPE_AVAILABLE && e->base_addr + e->length > top) {
+            top = e->base_addr + e->length;
+        }
+    }
+    if (top > 0x100000000ULL) top = 0x100000000ULL;
+    frame_count = (uint32_t)(top >> PAGE_SHIFT);
+
+    uint64_t array_size = page_align_up((uint64_t)frame_count * sizeof(PageFrame));
+    uintptr_t array_base = place_frame_array(mmap, mmap_end, array_size);
+    if (!array_base) {
+        frame_count = 0;
+        return;
+    }
+    frames = (PageFrame*)array_base;
+    frames_end = array_base + array_size;
+    reserve_range(array_base, array_size);
+    memset(frames, 0, array_size);
+
+    // Seed the free lists with every usable frame
+    for (struct memory_map_entry* e = mmap; (uintptr_t)e < mmap_end;
+         e = (struct memory_map_entry*)((uintptr_t)e + e->size + sizeof(e->size))) {
+        if (e->type != MMAP_TYPE_AVAILABLE || e->base_addr >= top) continue;
+
+        uint64_t limit = e->base_addr + e->length;
+        add_region(e->base_addr, limit < top ? limit : top);
+    }
+}
+
+// Allocate a block of 2^order frames
+uintptr_t alloc_pages(unsigned int order) {
+    if (order > PMM_MAX_ORDER) return 0;
+
+    unsigned int current = order;
+    while (current <= PMM_MAX_ORDER && free_head[current] == FRAME_NONE) {
+        current++;
+    }
+    if (current > PMM_MAX_ORDER) return 0; // Out of memory
+
+    uint32_t pfn = free_head[current];
+    list_remove(current, pfn);
+
+    // Split down to the requested order, returning the upper halves
+    while (current > order) {
+        current--;
+        list_push(current, pfn + (1u << current));
+    }
+
+    frames[pfn].order = order;
+    frames[pfn].state = FRAME_ALLOCATED;
+    return (uintptr_t)pfn << PAGE_SHIFT;
+}
+
+// Free a block of 2^order frames
+void free_pages(uintptr_t addr, unsigned int order) {
+    uint32_t pfn = addr >> PAGE_SHIFT;
+    if (pfn >= frame_count || order > PMM_MAX_ORDER) return;
+    if (frames[pfn].state != FRAME_ALLOCATED || frames[pfn].order != order) return;
+
+    free_block(pfn, order);
+}
+
+// End of the frame descriptor array
+uintptr_t pmm_metadata_end(void) {
+    return frames_end;
+}
+
+// Number of free blocks of the given order
+size_t pmm_free_blocks(unsigned int order) {
+    return order <= PMM_MAX_ORDER ? free_count[order] : 0;
+}
+
+// Number of free frames
+size_t pmm_free_frames(void) {
+    size_t total = 0;
+    for (unsigned int i = 0; i <= PMM_MAX_ORDER; i++) {
+        total += free_count[i] << i;
+    }
+    return total;
+}
+
+// Number of frames handed to the allocator at boot
+size_t pmm_total_frames(void) {
+    return usable_frames;
+}
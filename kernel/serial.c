@@ -0,0 +1,281 @@
+#include "include/serial.h"
+#include "include/io.h"
+#include "include/pic.h"
+#include "include/asm.h"
+#include "include/stdio.h"
+#include "../include/config.h"
+
+// UART registers, as offsets from the port base
+#define UART_DATA 0             // RBR / THR; divisor low with DLAB
+#define UART_IER 1              // Interrupt enable; divisor high with DLAB
+#define UART_IIR 2              // Interrupt identification (read)
+#define UART_FCR 2              // FIFO control (write)
+#define UART_LCR 3              // Line control
+#define UART_MCR 4              // Modem control
+#define UART_LSR 5              // Line status
+#define UART_MSR 6              // Modem status
+
+#define IER_RX 0x01             // Received data available
+#define IER_TX 0x02             // Transmit holding register empty
+#define IIR_NONE 0x01           // No interrupt pending
+#define IIR_ID 0x0E
+#define IIR_MSR 0x00
+#define IIR_THRE 0x02
+#define IIR_RX 0x04
+#define IIR_LSR 0x06
+#define IIR_TIMEOUT 0x0C
+#define IIR_FIFO 0xC0           // Both set on a working 16550A FIFO
+#define FCR_ENABLE 0x07         // Enable and clear both FIFOs
+#define FCR_TRIGGER_14 0xC0     // RX interrupt at 14 bytes
+#define LCR_8N1 0x03
+#define LCR_DLAB 0x80
+#define MCR_DTR 0x01
+#define MCR_RTS 0x02
+#define MCR_OUT1 0x04
+#define MCR_OUT2 0x08           // Gates the UART's IRQ line
+#define MCR_LOOP 0x10
+#define LSR_DR 0x01             // Data ready
+#define LSR_THRE 0x20           // Transmit holding register empty
+
+#define UART_CLOCK 115200
+#define UART_FIFO_SIZE 16
+
+// Polls per byte before the panic path gives up on a stuck line
+#define PANIC_SPIN 100000
+
+// Work done per interrupt before yielding, so a babbling line cannot
+// hold the CPU
+#define IRQ_ROUNDS 16
+
+// State of one port
+typedef struct {
+    uint16_t base;
+    uint8_t irq;
+    bool present;
+    uint8_t tx_burst;           // Bytes per THRE: FIFO depth or 1
+    uint8_t ier;
+    volatile uint32_t tx_head;  // Next byte to queue
+    volatile uint32_t tx_tail;  // Next byte to send
+    volatile uint32_t rx_head;
+    volatile uint32_t rx_tail;
+    uint32_t tx_dropped;        // Input bytes lost since the last note
+    char tx[SERIAL_TX_BUFFER];
+    char rx[SERIAL_RX_BUFFER];
+} SerialPort;
+
+static SerialPort ports[SERIAL_PORTS] = {
+    { .base = 0x3F8, .irq = 4 },
+    { .base = 0x2F8, .irq = 3 },
+    { .base = 0x3E8, .irq = 4 },
+    { .base = 0x2E8, .irq = 3 },
+};
+
+// Whether serial_init found the port
+bool serial_present(unsigned int port) {
+    return port < SERIAL_PORTS && ports[port].present;
+}
+
+// Program the interrupt enable register
+static void set_ier(SerialPort* p, uint8_t ier) {
+    if (p->ier != ier) {
+        p->ier = ier;
+        port_out_byte(p->base + UART_IER, ier);
+    }
+}
+
+// Top up the transmitter from the ring if it has room. One LSR read;
+// never waits. THRE interrupts stay on only while bytes are queued.
+static void tx_fill(SerialPort* p) {
+    if (p->tx_head != p->tx_tail && (port_in_byte(p->base + UART_LSR) & LSR_THRE)) {
+        for (unsigned int n = p->tx_burst; n && p->tx_head != p->tx_tail; n--) {
+            port_out_byte(p->base + UART_DATA, p->tx[p->tx_tail & (SERIAL_TX_BUFFER - 1)]);
+            p->tx_tail++;
+        }
+    }
+
+    uint8_t ier = p->tx_head != p->tx_tail ? (p->ier | IER_TX) : (p->ier & ~IER_TX);
+    set_ier(p, ier);
+}
+
+// Move what the UART has received into the ring, at most a FIFO's
+// worth per call so a line that keeps sending cannot hold the CPU
+static void rx_drain(SerialPort* p) {
+    for (int n = UART_FIFO_SIZE; n && (port_in_byte(p->base + UART_LSR) & LSR_DR); n--) {
+        char c = (char)port_in_byte(p->base + UART_DATA);
+        // Drop input nobody is reading
+        if (p->rx_head - p->rx_tail < SERIAL_RX_BUFFER) {
+            p->rx[p->rx_head & (SERIAL_RX_BUFFER - 1)] = c;
+            p->rx_head++;
+        }
+    }
+}
+
+// Program a port for baud 8N1 with FIFOs on
+bool serial_init(unsigned int port, uint32_t baud) {
+    if (port >= SERIAL_PORTS) return false;
+    SerialPort* p = &ports[port];
+    uint16_t base = p->base;
+
+    uint32_t divisor = baud && baud <= UART_CLOCK ? UART_CLOCK / baud : 1;
+
+    port_out_byte(base + UART_IER, 0);
+    port_out_byte(base + UART_LCR, LCR_DLAB);
+    port_out_byte(base + UART_DATA, (uint8_t)divisor);
+    port_out_byte(base + UART_IER, (uint8_t)(divisor >> 8));
+    port_out_byte(base + UART_LCR, LCR_8N1);
+    port_out_byte(base + UART_FCR, FCR_ENABLE | FCR_TRIGGER_14);
+
+    // A byte sent in loopback mode must come straight back
+    port_out_byte(base + UART_MCR, MCR_LOOP | MCR_RTS | MCR_OUT1 | MCR_OUT2);
+    port_out_byte(base + UART_DATA, 0xAE);
+    if (port_in_byte(base + UART_DATA) != 0xAE) {
+        p->present = false;
+        return false;
+    }
+
+    port_out_byte(base + UART_MCR, MCR_DTR | MCR_RTS | MCR_OUT2);
+    p->tx_burst = (port_in_byte(base + UART_IIR) & IIR_FIFO) == IIR_FIFO ? UART_FIFO_SIZE : 1;
+    p->tx_head = p->tx_tail = 0;
+    p->tx_dropped = 0;
+    p->rx_head = p->rx_tail = 0;
+    p->ier = 0;
+    p->present = true;
+
+    rx_drain(p);
+    set_ier(p, IER_RX);
+    pic_unmask(p->irq);
+    return true;
+}
+
+// Free space in the TX ring
+static inline uint32_t tx_room(const SerialPort* p) {
+    return SERIAL_TX_BUFFER - (p->tx_head - p->tx_tail);
+}
+
+// Queue a line saying how much output was lost, if it fits. Until it
+// does, later output is dropped too, so the note marks the gap.
+static bool tx_note_dropped(SerialPort* p) {
+    char note[48];
+    int length = snprintf(note, sizeof(note), "\r\n[serial: %u bytes dropped]\r\n", p->tx_dropped);
+    if (length < 0 || tx_room(p) < (uint32_t)length) return false;
+
+    for (int i = 0; i < length; i++) {
+        p->tx[p->tx_head++ & (SERIAL_TX_BUFFER - 1)] = note[i];
+    }
+    p->tx_dropped = 0;
+    return true;
+}
+
+// Queue bytes for transmission
+size_t serial_write(unsigned int port, const char* data, size_t length) {
+    if (!serial_present(port)) return 0;
+    SerialPort* p = &ports[port];
+
+    uint32_t eflags = READ_EFLAGS();
+    CLI();
+
+    // After a loss nothing more is queued until the note about it is
+    size_t queued = 0;
+    if (!p->tx_dropped || tx_note_dropped(p)) {
+        while (queued < length) {
+            char c = data[queued];
+            uint32_t need = c == '\n' ? 2 : 1;
+            if (tx_room(p) < need) break;
+            if (c == '\n') {
+                p->tx[p->tx_head++ & (SERIAL_TX_BUFFER - 1)] = '\r';
+            }
+            p->tx[p->tx_head++ & (SERIAL_TX_BUFFER - 1)] = c;
+            queued++;
+        }
+    }
+    p->tx_dropped += length - queued;
+
+    tx_fill(p);
+    WRITE_EFLAGS(eflags);
+    return queued;
+}
+
+// Take up to max received bytes
+size_t serial_read(unsigned int port, char* buffer, size_t max) {
+    if (!serial_present(port)) return 0;
+    SerialPort* p = &ports[port];
+
+    size_t count = 0;
+    while (count < max && p->rx_tail != p->rx_head) {
+        buffer[count++] = p->rx[p->rx_tail & (SERIAL_RX_BUFFER - 1)];
+        MEMORY_BARRIER();
+        p->rx_tail++;
+    }
+    return count;
+}
+
+// Service every port without relying on interrupts
+void serial_poll(void) {
+    uint32_t eflags = READ_EFLAGS();
+    CLI();
+    for (unsigned int i = 0; i < SERIAL_PORTS; i++) {
+        if (!ports[i].present) continue;
+        rx_drain(&ports[i]);
+        tx_fill(&ports[i]);
+    }
+    WRITE_EFLAGS(eflags);
+}
+
+// IRQ 3 and 4 handler; each line is shared by two ports
+void serial_handle_irq(uint8_t irq) {
+    for (unsigned int i = 0; i < SERIAL_PORTS; i++) {
+        SerialPort* p = &ports[i];
+        if (!p->present || p->irq != irq) continue;
+
+        for (int round = 0; round < IRQ_ROUNDS; round++) {
+            uint8_t iir = port_in_byte(p->base + UART_IIR);
+            if (iir & IIR_NONE) break;
+
+            switch (iir & IIR_ID) {
+                case IIR_RX:
+                case IIR_TIMEOUT:
+                    rx_drain(p);
+                    break;
+                case IIR_THRE:
+                    tx_fill(p);
+                    break;
+                case IIR_LSR:
+                    port_in_byte(p->base + UART_LSR);
+                    break;
+                case IIR_MSR:
+                    port_in_byte(p->base + UART_MSR);
+                    break;
+            }
+        }
+    }
+}
+
+// Write to the console port
+void serial_console_write(const char* text, size_t length) {
+    serial_write(CONFIG_SERIAL_PORT, text, length);
+}
+
+// Send one byte by polling, giving up if the line stays busy
+static void panic_putc(uint16_t base, char c) {
+    for (int spin = PANIC_SPIN; spin && !(port_in_byte(base + UART_LSR) & LSR_THRE); spin--) {
+        NOP();
+    }
+    port_out_byte(base + UART_DATA, (uint8_t)c);
+}
+
+// Drain the console queue, then text, by polling
+void serial_panic_write(const char* text, size_t length) {
+    if (!serial_present(CONFIG_SERIAL_PORT)) return;
+    SerialPort* p = &ports[CONFIG_SERIAL_PORT];
+
+    CLI();
+    set_ier(p, 0);
+
+    while (p->tx_tail != p->tx_head) {
+        panic_putc(p->base, p->tx[p->tx_tail++ & (SERIAL_TX_BUFFER - 1)]);
+    }
+    for (size_t i = 0; i < length; i++) {
+        if (text[i] == '\n') panic_putc(p->base, '\r');
+        panic_putc(p->base, text[i]);
+    }
+}
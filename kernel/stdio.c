@@ -1,51 +1,311 @@
 #include "include/stdio.h"
 #include "include/string.h"
+#include "include/terminal.h"
+#include <stdint.h>
 
-// Helper function to convert number to string
-static void number_to_string(char* str, int num, int base) {
-    int i = 0;
-    int is_negative = 0;
-    
-    // Handle negative numbers
-    if (num < 0) {
-        is_negative = 1;
-        num = -num;
+// Conversion flags
+#define FMT_LEFT  0x01          // '-': pad on the right
+#define FMT_ZERO  0x02          // '0': pad numbers with zeros
+#define FMT_PLUS  0x04          // '+': always print a sign
+#define FMT_SPACE 0x08          // ' ': space where a '+' would go
+#define FMT_ALT   0x10          // '#': 0x / 0 prefix
+
+// Integer argument sizes
+enum { ARG_INT, ARG_CHAR, ARG_SHORT, ARG_LONG, ARG_LLONG, ARG_SIZE };
+
+// Longest number: 22 octal digits for a 64-bit value
+#define NUMBER_BUFFER 24
+
+// Two decimal digits per table entry, so each division by 100 yields two
+// characters
+static const char digit_pairs[201] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+static const char lower_digits[] = "0123456789abcdef";
+static const char upper_digits[] = "0123456789ABCDEF";
+
+// Bounded output: everything past size - 1 is counted but dropped
+typedef struct {
+    char* buf;
+    size_t size;
+    size_t len;
+} FormatBuffer;
+
+// Where kprintf output goes
+static KprintfSink kprintf_sink = terminal_write;
+
+// Append count bytes
+static void out_bytes(FormatBuffer* out, const char* src, size_t count) {
+    if (out->len + 1 < out->size) {
+        size_t room = out->size - 1 - out->len;
+        memcpy(out->buf + out->len, src, count < room ? count : room);
     }
-    
-    // Handle zero
-    if (num == 0) {
-        str[i++] = '0';
-        str[i] = '\0';
-        return;
+    out->len += count;
+}
+
+// Append count copies of c
+static void out_fill(FormatBuffer* out, char c, size_t count) {
+    if (out->len + 1 < out->size) {
+        size_t room = out->size - 1 - out->len;
+        memset(out->buf + out->len, c, count < room ? count : room);
     }
-    
-    // Convert number to string
-    while (num > 0) {
-        int rem = num % base;
-        str[i++] = (rem > 9) ? (rem - 10) + 'a' : rem + '0';
-        num = num / base;
+    out->len += count;
+}
+
+// Divide *n by base in place and return the remainder, using two 32-bit
+// divides since there is no libgcc to provide __udivdi3
+static uint32_t div_u64(uint64_t* n, uint32_t base) {
+    uint32_t high = (uint32_t)(*n >> 32);
+    uint32_t low = (uint32_t)*n;
+    uint32_t rem = high % base;
+    high /= base;
+    __asm__("divl %4" : "=a" (low), "=d" (rem) : "0" (low), "1" (rem), "rm" (base));
+    *n = ((uint64_t)high << 32) | low;
+    return rem;
+}
+
+// Write value in decimal so that it ends at end, returning its start
+static char* format_dec32(char* end, uint32_t value) {
+    while (value >= 100) {
+        uint32_t pair = (value % 100) * 2;
+        value /= 100;
+        *--end = digit_pairs[pair + 1];
+        *--end = digit_pairs[pair];
     }
-    
-    // Add negative sign if needed
-    if (is_negative) {
-        str[i++] = '-';
+    if (value >= 10) {
+        *--end = digit_pairs[value * 2 + 1];
+        *--end = digit_pairs[value * 2];
+    } else {
+        *--end = (char)('0' + value);
     }
-    
-    // Reverse the string
-    int start = 0;
-    int end = i - 1;
-    while (start < end) {
-        char temp = str[start];
-        str[start] = str[end];
-        str[end] = temp;
-        start++;
-        end--;
+    return end;
+}
+
+// 64-bit decimal, nine digits per 64-bit divide
+static char* format_dec(char* end, uint64_t value) {
+    while (value >> 32) {
+        char* start = format_dec32(end, div_u64(&value, 1000000000));
+        while (end - start < 9) {
+            *--start = '0';
+        }
+        end = start;
     }
-    
-    str[i] = '\0';
+    return format_dec32(end, (uint32_t)value);
 }
 
-// Minimal sprintf implementation
+// Power-of-two bases only need shifts
+static char* format_shift(char* end, uint64_t value, unsigned int shift, const char* digits) {
+    uint32_t mask = (1u << shift) - 1;
+    do {
+        *--end = digits[(uint32_t)value & mask];
+        value >>= shift;
+    } while (value);
+    return end;
+}
+
+// Pad and emit one formatted number
+static void out_number(FormatBuffer* out, int flags, int width, int precision,
+                       const char* prefix, const char* digits, size_t count) {
+    size_t prefix_len = strlen(prefix);
+    size_t zeros = precision > 0 && (size_t)precision > count ? (size_t)precision - count : 0;
+    size_t total = prefix_len + zeros + count;
+    size_t pad = width > 0 && (size_t)width > total ? (size_t)width - total : 0;
+
+    if ((flags & FMT_ZERO) && !(flags & FMT_LEFT) && precision < 0) {
+        zeros += pad;
+        pad = 0;
+    }
+
+    if (!(flags & FMT_LEFT)) out_fill(out, ' ', pad);
+    out_bytes(out, prefix, prefix_len);
+    out_fill(out, '0', zeros);
+    out_bytes(out, digits, count);
+    if (flags & FMT_LEFT) out_fill(out, ' ', pad);
+}
+
+// Read a decimal field width or precision
+static int parse_int(const char** format) {
+    int value = 0;
+    while (**format >= '0' && **format <= '9') {
+        value = value * 10 + (*(*format)++ - '0');
+    }
+    return value;
+}
+
+// Format into str, never writing more than size bytes including the
+// terminator. Supports %d %i %u %x %X %o %p %c %s %% with the - 0 + space
+// and # flags, width, precision (both may be *), and the hh h l ll z
+// length modifiers. Returns the length the full output would have had.
+int vsnprintf(char* str, size_t size, const char* format, va_list args) {
+    FormatBuffer out = { str, size, 0 };
+
+    while (*format) {
+        if (*format != '%') {
+            const char* run = format;
+            while (*format && *format != '%') format++;
+            out_bytes(&out, run, (size_t)(format - run));
+            continue;
+        }
+        format++;
+
+        int flags = 0;
+        for (;; format++) {
+            if (*format == '-') flags |= FMT_LEFT;
+            else if (*format == '0') flags |= FMT_ZERO;
+            else if (*format == '+') flags |= FMT_PLUS;
+            else if (*format == ' ') flags |= FMT_SPACE;
+            else if (*format == '#') flags |= FMT_ALT;
+            else break;
+        }
+
+        int width = 0;
+        if (*format == '*') {
+            format++;
+            width = va_arg(args, int);
+            if (width < 0) {
+                flags |= FMT_LEFT;
+                width = -width;
+            }
+        } else {
+            width = parse_int(&format);
+        }
+
+        int precision = -1;
+        if (*format == '.') {
+            format++;
+            if (*format == '*') {
+                format++;
+                precision = va_arg(args, int);
+            } else {
+                precision = parse_int(&format);
+            }
+        }
+
+        int size_mod = ARG_INT;
+        if (*format == 'h') {
+            format++;
+            size_mod = ARG_SHORT;
+            if (*format == 'h') {
+                format++;
+                size_mod = ARG_CHAR;
+            }
+        } else if (*format == 'l') {
+            format++;
+            size_mod = ARG_LONG;
+            if (*format == 'l') {
+                format++;
+                size_mod = ARG_LLONG;
+            }
+        } else if (*format == 'z') {
+            format++;
+            size_mod = ARG_SIZE;
+        }
+
+        char conv = *format;
+        if (conv == '\0') break;
+        format++;
+
+        char number[NUMBER_BUFFER];
+        char* end = number + sizeof(number);
+        char* start = end;
+        const char* prefix = "";
+        uint64_t value = 0;
+
+        switch (conv) {
+            case 'd':
+            case 'i': {
+                int64_t sval;
+                if (size_mod == ARG_LLONG) sval = va_arg(args, long long);
+                else if (size_mod == ARG_LONG) sval = va_arg(args, long);
+                else sval = va_arg(args, int);
+                if (size_mod == ARG_CHAR) sval = (signed char)sval;
+                if (size_mod == ARG_SHORT) sval = (short)sval;
+
+                value = sval < 0 ? 0 - (uint64_t)sval : (uint64_t)sval;
+                if (sval < 0) prefix = "-";
+                else if (flags & FMT_PLUS) prefix = "+";
+                else if (flags & FMT_SPACE) prefix = " ";
+                if (value || precision != 0) start = format_dec(end, value);
+                out_number(&out, flags, width, precision, prefix, start, (size_t)(end - start));
+                break;
+            }
+            case 'u':
+            case 'x':
+            case 'X':
+            case 'o': {
+                if (size_mod == ARG_LLONG) value = va_arg(args, unsigned long long);
+                else if (size_mod == ARG_LONG) value = va_arg(args, unsigned long);
+                else if (size_mod == ARG_SIZE) value = va_arg(args, size_t);
+                else value = va_arg(args, unsigned int);
+                if (size_mod == ARG_CHAR) value = (unsigned char)value;
+                if (size_mod == ARG_SHORT) value = (unsigned short)value;
+
+                if (value || precision != 0) {
+                    if (conv == 'u') start = format_dec(end, value);
+                    else if (conv == 'o') start = format_shift(end, value, 3, lower_digits);
+                    else start = format_shift(end, value, 4, conv == 'x' ? lower_digits : upper_digits);
+                }
+                if ((flags & FMT_ALT) && value) {
+                    if (conv == 'x') prefix = "0x";
+                    else if (conv == 'X') prefix = "0X";
+                }
+                if ((flags & FMT_ALT) && conv == 'o' && (start == end || *start != '0')) {
+                    *--start = '0';
+                }
+                out_number(&out, flags, width, precision, prefix, start, (size_t)(end - start));
+                break;
+            }
+            case 'p': {
+                // Always the full eight digits, like the fault reports
+                value = (uintptr_t)va_arg(args, void*);
+                start = format_shift(end, value, 4, lower_digits);
+                if (precision < 8) precision = 8;
+                out_number(&out, flags & FMT_LEFT, width, precision, "0x", start, (size_t)(end - start));
+                break;
+            }
+            case 'c': {
+                char c = (char)va_arg(args, int);
+                size_t pad = width > 1 ? (size_t)width - 1 : 0;
+                if (!(flags & FMT_LEFT)) out_fill(&out, ' ', pad);
+                out_bytes(&out, &c, 1);
+                if (flags & FMT_LEFT) out_fill(&out, ' ', pad);
+                break;
+            }
+            case 's': {
+                const char* s = va_arg(args, const char*);
+                if (!s) s = "(null)";
+                size_t len = 0;
+                if (precision >= 0) {
+                    while (len < (size_t)precision && s[len]) len++;
+                } else {
+                    len = strlen(s);
+                }
+                size_t pad = width > 0 && (size_t)width > len ? (size_t)width - len : 0;
+                if (!(flags & FMT_LEFT)) out_fill(&out, ' ', pad);
+                out_bytes(&out, s, len);
+                if (flags & FMT_LEFT) out_fill(&out, ' ', pad);
+                break;
+            }
+            case '%':
+                out_bytes(&out, "%", 1);
+                break;
+            default:
+                // Unknown conversion: print it as written
+                out_bytes(&out, "%", 1);
+                out_bytes(&out, &conv, 1);
+                break;
+        }
+    }
+
+    if (size > 0) {
+        str[out.len < size ? out.len : size - 1] = '\0';
+    }
+    return (int)out.len;
+}
+
+// Format into str with no bound; prefer snprintf
 int sprintf(char* str, const char* format, ...) {
     va_list args;
     va_start(args, format);
@@ -54,52 +314,12 @@ int sprintf(char* str, const char* format, ...) {
     return result;
 }
 
-// Minimal vsprintf implementation
+// Unbounded vsnprintf
 int vsprintf(char* str, const char* format, va_list args) {
-    int i = 0;
-    int j = 0;
-    
-    while (format[i] != '\0') {
-        if (format[i] == '%') {
-            i++;
-            switch (format[i]) {
-                case 'd': {
-                    int num = va_arg(args, int);
-                    char num_str[32];
-                    number_to_string(num_str, num, 10);
-                    int k = 0;
-                    while (num_str[k] != '\0') {
-                        str[j++] = num_str[k++];
-                    }
-                    break;
-                }
-                case 's': {
-                    char* s = va_arg(args, char*);
-                    int k = 0;
-                    while (s[k] != '\0') {
-                        str[j++] = s[k++];
-                    }
-                    break;
-                }
-                case '%': {
-                    str[j++] = '%';
-                    break;
-                }
-                default:
-                    str[j++] = format[i];
-                    break;
-            }
-        } else {
-            str[j++] = format[i];
-        }
-        i++;
-    }
-    
-    str[j] = '\0';
-    return j;
+    return vsnprintf(str, SIZE_MAX, format, args);
 }
 
-// Minimal snprintf implementation
+// Bounded sprintf
 int snprintf(char* str, size_t size, const char* format, ...) {
     va_list args;
     va_start(args, format);
@@ -108,49 +328,27 @@ int snprintf(char* str, size_t size, const char* format, ...) {
     return result;
 }
 
-// Minimal vsnprintf implementation
-int vsnprintf(char* str, size_t size, const char* format, va_list args) {
-    if (size == 0) return 0;
-    
-    size_t i = 0;
-    size_t j = 0;
-    
-    while (format[i] != '\0' && j < size - 1) {
-        if (format[i] == '%') {
-            i++;
-            switch (format[i]) {
-                case 'd': {
-                    int num = va_arg(args, int);
-                    char num_str[32];
-                    number_to_string(num_str, num, 10);
-                    size_t k = 0;
-                    while (num_str[k] != '\0' && j < size - 1) {
-                        str[j++] = num_str[k++];
-                    }
-                    break;
-                }
-                case 's': {
-                    char* s = va_arg(args, char*);
-                    size_t k = 0;
-                    while (s[k] != '\0' && j < size - 1) {
-                        str[j++] = s[k++];
-                    }
-                    break;
-                }
-                case '%': {
-                    str[j++] = '%';
-                    break;
-                }
-                default:
-                    str[j++] = format[i];
-                    break;
-            }
-        } else {
-            str[j++] = format[i];
-        }
-        i++;
+// Format on the stack and hand the result to the sink in one call
+int vkprintf(const char* format, va_list args) {
+    char buf[KPRINTF_BUFFER];
+    int len = vsnprintf(buf, sizeof(buf), format, args);
+    size_t count = (size_t)len < sizeof(buf) ? (size_t)len : sizeof(buf) - 1;
+    if (count) {
+        kprintf_sink(buf, count);
     }
-    
-    str[j] = '\0';
-    return j;
-} 
\ No newline at end of file
+    return len;
+}
+
+// printf for kernel diagnostics
+int kprintf(const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    int result = vkprintf(format, args);
+    va_end(args);
+    return result;
+}
+
+// Redirect kprintf output
+void kprintf_set_sink(KprintfSink sink) {
+    kprintf_sink = sink ? sink : terminal_write;
+}
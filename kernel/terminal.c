@@ -1,23 +1,214 @@
 #include "include/terminal.h"
 #include "include/io.h"
+#include "include/asm.h"
 #include <stddef.h>
 #include <stdint.h>
 #include <stdbool.h>
 #include <string.h>
+#include "../include/config.h"
 
 // VGA text mode constants
 #define VGA_WIDTH 80
 #define VGA_HEIGHT 25
 #define VGA_MEMORY 0xB8000
 
+// Text memory behind 0xB8000 is 32 KB, room for this many rows. The
+// screen is a 25-row window into it that the CRTC start address moves.
+#define VRAM_ROWS (32768 / (VGA_WIDTH * 2))
+
+// CRTC registers
+#define CRTC_INDEX 0x3D4
+#define CRTC_DATA 0x3D5
+#define CRTC_START_HIGH 0x0C
+#define CRTC_START_LOW 0x0D
+#define CRTC_CURSOR_HIGH 0x0E
+#define CRTC_CURSOR_LOW 0x0F
+
+// Lines kept after they scroll off the top
+#define SCROLLBACK_LINES CONFIG_TERM_SCROLLBACK
+
 // Function prototypes
-void update_cursor(void);
+void terminal_flush(void);
 
 // Terminal state
 static size_t terminal_row = 0;
 static size_t terminal_column = 0;
 static uint8_t terminal_color = 0x0F; // White on black
-static uint16_t* terminal_buffer = (uint16_t*) VGA_MEMORY;
+static uint16_t* const vga_memory = (uint16_t*) VGA_MEMORY;
+
+// The screen is drawn in RAM and copied to VGA memory a row at a time by
+// terminal_flush, so output never reads video memory and writes it only
+// in whole rows. The shadow is a ring of rows: shadow_first is the slot
+// holding screen row 0, and dirty_rows has a bit per slot.
+static uint16_t shadow[VGA_HEIGHT][VGA_WIDTH];
+static size_t shadow_first = 0;
+static volatile uint32_t dirty_rows = 0;
+
+#define ALL_ROWS_DIRTY ((1u << VGA_HEIGHT) - 1)
+
+// VGA row where the live screen starts. Rows above it, back to the last
+// rebase, still hold the lines that scrolled off.
+static size_t screen_top = 0;
+
+// Ring of lines that scrolled off the top, newest at scrollback_head - 1
+static uint16_t scrollback[SCROLLBACK_LINES][VGA_WIDTH];
+static size_t scrollback_head = 0;
+static size_t scrollback_count = 0;
+
+// How many lines above the live screen the display is showing
+static size_t view_offset = 0;
+
+// Where text written to the screen is copied, if anywhere
+static TerminalMirror terminal_mirror = NULL;
+
+// Display start address and cursor position as last written to the
+// CRTC. Each CRTC write is a port access, which under virtualization is
+// a VM exit, so both are tracked here and written out by terminal_flush
+// only at the end of a write and before input blocks.
+static size_t display_start = 0;
+static size_t display_shown = (size_t)-1;
+static size_t cursor_shown = (size_t)-1;
+
+// Choose the cell the display should start from
+static void set_display_start(size_t cell) {
+    display_start = cell;
+}
+
+// Shadow slot of a screen row
+static inline size_t row_slot(size_t row) {
+    size_t slot = shadow_first + row;
+    return slot >= VGA_HEIGHT ? slot - VGA_HEIGHT : slot;
+}
+
+// Shadow cells of a screen row
+static inline uint16_t* screen_row(size_t row) {
+    return shadow[row_slot(row)];
+}
+
+// Queue a screen row for the next flush. The bit is set after the
+// cells are written, so a flush from an interrupt handler in between at
+// worst copies the row twice.
+static inline void mark_dirty(size_t row) {
+    MEMORY_BARRIER();
+    dirty_rows |= 1u << row_slot(row);
+}
+
+// Copy one shadow slot to its row in VGA memory
+static void flush_slot(size_t slot) {
+    size_t row = slot >= shadow_first ? slot - shadow_first : slot + VGA_HEIGHT - shadow_first;
+    memcpy(vga_memory + (screen_top + row) * VGA_WIDTH, shadow[slot], VGA_WIDTH * 2);
+}
+
+// Fill one row with blanks in the current color
+static void clear_row(uint16_t* row) {
+    uint32_t blank = (uint16_t)' ' | (uint16_t)terminal_color << 8;
+    memset32((uint32_t*)row, blank | blank << 16, VGA_WIDTH / 2);
+}
+
+// Scroll the live screen up one line. The shadow ring and the window
+// into VGA memory both advance a row, so rows already on screen are not
+// copied at all; the CRTC start address does the move. Only when the
+// window reaches the end of VGA memory does it go back to the top,
+// redrawn from the shadow. Runs with interrupts off, since a handler
+// that writes to the terminal flushes using the same ring positions.
+static void scroll_up(void) {
+    uint32_t eflags = READ_EFLAGS();
+    CLI();
+
+    size_t slot = shadow_first;
+    uint32_t bit = 1u << slot;
+
+    // The departing row stays visible in the scrollback above the window
+    if (dirty_rows & bit) {
+        dirty_rows &= ~bit;
+        flush_slot(slot);
+    }
+    memcpy(scrollback[scrollback_head], shadow[slot], sizeof(scrollback[0]));
+    scrollback_head = (scrollback_head + 1) % SCROLLBACK_LINES;
+    if (scrollback_count < SCROLLBACK_LINES) scrollback_count++;
+
+    if (screen_top + VGA_HEIGHT < VRAM_ROWS) {
+        screen_top++;
+    } else {
+        screen_top = 0;
+        dirty_rows = ALL_ROWS_DIRTY;
+    }
+
+    // The old top slot becomes the new bottom row
+    shadow_first = row_slot(1);
+    clear_row(shadow[slot]);
+    dirty_rows |= bit;
+    set_display_start(screen_top * VGA_WIDTH);
+
+    WRITE_EFLAGS(eflags);
+}
+
+// Move to the start of the next line, scrolling at the bottom
+static void new_line(void) {
+    terminal_column = 0;
+    if (++terminal_row == VGA_HEIGHT) {
+        scroll_up();
+        terminal_row = VGA_HEIGHT - 1;
+    }
+}
+
+// Show the scrollback view_offset lines up. Views that still lie in VGA
+// memory above the live screen only need a new start address; older
+// ones are assembled in the rows below it.
+static void show_view(void) {
+    if (view_offset <= screen_top) {
+        set_display_start((screen_top - view_offset) * VGA_WIDTH);
+        return;
+    }
+
+    uint32_t eflags = READ_EFLAGS();
+    CLI();
+
+    // Make room for a staging window below the live screen
+    if (screen_top + 2 * VGA_HEIGHT > VRAM_ROWS) {
+        screen_top = 0;
+        dirty_rows = ALL_ROWS_DIRTY;
+    }
+
+    uint16_t* stage = vga_memory + (screen_top + VGA_HEIGHT) * VGA_WIDTH;
+    for (size_t row = 0; row < VGA_HEIGHT; row++) {
+        const uint16_t* src;
+        if (row < view_offset) {
+            size_t age = view_offset - row;
+            src = scrollback[(scrollback_head + SCROLLBACK_LINES - age) % SCROLLBACK_LINES];
+        } else {
+            src = screen_row(row - view_offset);
+        }
+        memcpy(stage + row * VGA_WIDTH, src, VGA_WIDTH * 2);
+    }
+    set_display_start((screen_top + VGA_HEIGHT) * VGA_WIDTH);
+
+    WRITE_EFLAGS(eflags);
+}
+
+// Move the view lines further back (positive) or forward (negative)
+void terminal_scroll_view(int lines) {
+    size_t offset = view_offset;
+    if (lines < 0) {
+        offset = (size_t)-lines >= offset ? 0 : offset - (size_t)-lines;
+    } else {
+        offset += (size_t)lines;
+        if (offset > scrollback_count) offset = scrollback_count;
+    }
+
+    if (offset != view_offset) {
+        view_offset = offset;
+        show_view();
+    }
+}
+
+// Return the display to the live screen
+void terminal_view_live(void) {
+    if (view_offset) {
+        view_offset = 0;
+        set_display_start(screen_top * VGA_WIDTH);
+    }
+}
 
 // Create a VGA entry color byte
 uint8_t vga_entry_color(uint8_t fg, uint8_t bg) {
@@ -29,21 +220,27 @@ void terminal_initialize(void) {
     terminal_row = 0;
     terminal_column = 0;
     terminal_color = vga_entry_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
-    terminal_buffer = (uint16_t*)VGA_MEMORY;
+    scrollback_head = 0;
+    scrollback_count = 0;
     terminal_clear();
 }
 
-// Clear the entire screen
+// Clear the entire screen. The scrollback is kept.
 void terminal_clear(void) {
+    uint32_t eflags = READ_EFLAGS();
+    CLI();
+    screen_top = 0;
+    view_offset = 0;
+    shadow_first = 0;
     for (size_t y = 0; y < VGA_HEIGHT; y++) {
-        for (size_t x = 0; x < VGA_WIDTH; x++) {
-            const size_t index = y * VGA_WIDTH + x;
-            terminal_buffer[index] = (uint16_t)' ' | (uint16_t)terminal_color << 8;
-        }
+        clear_row(shadow[y]);
     }
+    dirty_rows = ALL_ROWS_DIRTY;
+    set_display_start(0);
+    WRITE_EFLAGS(eflags);
+
     terminal_row = 0;
     terminal_column = 0;
-    update_cursor();
 }
 
 // Move cursor to specific position
@@ -51,7 +248,6 @@ void terminal_move_cursor(int x, int y) {
     if (x >= 0 && x < VGA_WIDTH && y >= 0 && y < VGA_HEIGHT) {
         terminal_column = x;
         terminal_row = y;
-        update_cursor();
     }
 }
 
@@ -60,104 +256,139 @@ void terminal_set_color(uint8_t color) {
     terminal_color = color;
 }
 
-// Put character at current position
-void terminal_put_char(char c) {
+// Store a character and advance, leaving the hardware cursor alone
+static void store_char(char c) {
+    // New output brings the display back from the scrollback
+    terminal_view_live();
+
     if (c == '\n') {
-        terminal_column = 0;
-        if (++terminal_row == VGA_HEIGHT) {
-            terminal_row = 0;
-        }
+        new_line();
         return;
     }
 
-    const size_t index = terminal_row * VGA_WIDTH + terminal_column;
-    terminal_buffer[index] = (uint16_t)c | (uint16_t)terminal_color << 8;
+    screen_row(terminal_row)[terminal_column] = (uint16_t)c | (uint16_t)terminal_color << 8;
+    mark_dirty(terminal_row);
 
     if (++terminal_column == VGA_WIDTH) {
-        terminal_column = 0;
-        if (++terminal_row == VGA_HEIGHT) {
-            terminal_row = 0;
-        }
+        new_line();
+    }
+}
+
+// Put character at current position
+void terminal_put_char(char c) {
+    store_char(c);
+    if (terminal_mirror) {
+        terminal_mirror(&c, 1);
     }
-    update_cursor();
+}
+
+// Write size bytes and bring the screen up to date once at the end
+void terminal_write(const char* data, size_t size) {
+    for (size_t i = 0; i < size; i++) {
+        store_char(data[i]);
+    }
+    terminal_flush();
+    if (terminal_mirror) {
+        terminal_mirror(data, size);
+    }
+}
+
+// Copy terminal text to mirror as well
+void terminal_set_mirror(TerminalMirror mirror) {
+    terminal_mirror = mirror;
 }
 
 // Write string to terminal
 void terminal_write_string(const char* str) {
-    for (size_t i = 0; str[i] != '\0'; i++) {
-        terminal_put_char(str[i]);
-    }
+    terminal_write(str, strlen(str));
 }
 
 // Write decimal number to terminal
 void terminal_write_dec(uint32_t num) {
-    if (num == 0) {
-        terminal_put_char('0');
-        return;
-    }
-
-    char buffer[32];
-    int i = 0;
-    while (num > 0) {
-        buffer[i++] = '0' + (num % 10);
+    char buffer[16];
+    char* digit = buffer + sizeof(buffer);
+    do {
+        *--digit = '0' + (num % 10);
         num /= 10;
-    }
+    } while (num > 0);
 
-    while (--i >= 0) {
-        terminal_put_char(buffer[i]);
-    }
+    terminal_write(digit, (size_t)(buffer + sizeof(buffer) - digit));
 }
 
 // Put pixel in graphics mode
 void terminal_put_pixel(int x, int y, uint32_t color) {
-    // For now, we'll just write to VGA memory directly
+    // For now, we'll just draw a colored cell
     // In a real implementation, this would use a proper graphics mode
     if (x >= 0 && x < VGA_WIDTH && y >= 0 && y < VGA_HEIGHT) {
-        const size_t index = y * VGA_WIDTH + x;
-        terminal_buffer[index] = (uint16_t)' ' | (uint16_t)(color & 0x0F) << 8;
+        screen_row(y)[x] = (uint16_t)' ' | (uint16_t)(color & 0x0F) << 8;
+        mark_dirty(y);
     }
 }
 
 // Draw string in graphics mode
 void terminal_draw_string(int x, int y, const char* str, uint32_t color) {
+    if (x < 0 || y < 0 || y >= VGA_HEIGHT) return;
+
+    uint16_t* row = screen_row(y);
     for (size_t i = 0; str[i] != '\0'; i++) {
         if (x + i >= VGA_WIDTH) break;
-        const size_t index = y * VGA_WIDTH + (x + i);
-        terminal_buffer[index] = (uint16_t)str[i] | (uint16_t)(color & 0x0F) << 8;
+        row[x + i] = (uint16_t)str[i] | (uint16_t)(color & 0x0F) << 8;
     }
+    mark_dirty(y);
 }
 
-// Update hardware cursor position
-void update_cursor(void) {
-    uint16_t pos = terminal_row * VGA_WIDTH + terminal_column;
-    
-    port_out_byte(0x3D4, 0x0F);
-    port_out_byte(0x3D5, (uint8_t)(pos & 0xFF));
-    port_out_byte(0x3D4, 0x0E);
-    port_out_byte(0x3D5, (uint8_t)((pos >> 8) & 0xFF));
+// Copy dirty rows to VGA memory, then write the display start and
+// cursor position to the CRTC, skipping whichever has not changed.
+// Interrupts are held off so a handler writing to the terminal, such as
+// the keyboard's, cannot slip its own index write between an index and
+// its data.
+void terminal_flush(void) {
+    size_t pos = (screen_top + terminal_row) * VGA_WIDTH + terminal_column;
+    if (!dirty_rows && pos == cursor_shown && display_start == display_shown) return;
+
+    uint32_t eflags = READ_EFLAGS();
+    CLI();
+    uint32_t dirty = dirty_rows;
+    dirty_rows = 0;
+    while (dirty) {
+        flush_slot((size_t)__builtin_ctz(dirty));
+        dirty &= dirty - 1;
+    }
+
+    if (display_start != display_shown) {
+        display_shown = display_start;
+        port_out_byte(CRTC_INDEX, CRTC_START_HIGH);
+        port_out_byte(CRTC_DATA, (uint8_t)(display_start >> 8));
+        port_out_byte(CRTC_INDEX, CRTC_START_LOW);
+        port_out_byte(CRTC_DATA, (uint8_t)display_start);
+    }
+    if (pos != cursor_shown) {
+        cursor_shown = pos;
+        port_out_byte(CRTC_INDEX, CRTC_CURSOR_LOW);
+        port_out_byte(CRTC_DATA, (uint8_t)pos);
+        port_out_byte(CRTC_INDEX, CRTC_CURSOR_HIGH);
+        port_out_byte(CRTC_DATA, (uint8_t)(pos >> 8));
+    }
+    WRITE_EFLAGS(eflags);
 }
 
 void terminal_move_cursor_left(void) {
     if (terminal_column > 0) {
         terminal_column--;
-        update_cursor();
     }
     else if (terminal_row > 0) {
         terminal_row--;
         terminal_column = VGA_WIDTH - 1;
-        update_cursor();
     }
 }
 
 void terminal_move_cursor_right(void) {
     if (terminal_column < VGA_WIDTH - 1) {
         terminal_column++;
-        update_cursor();
     }
     else if (terminal_row < VGA_HEIGHT - 1) {
         terminal_row++;
         terminal_column = 0;
-        update_cursor();
     }
 }
 
@@ -165,36 +396,31 @@ void terminal_move_cursor_to(size_t row, size_t col) {
     if (row < VGA_HEIGHT && col < VGA_WIDTH) {
         terminal_row = row;
         terminal_column = col;
-        update_cursor();
     }
 }
 
 void terminal_delete_char(void) {
     if (terminal_column < VGA_WIDTH && terminal_row < VGA_HEIGHT) {
         // Move all characters after cursor one position left
-        for (size_t x = terminal_column; x < VGA_WIDTH - 1; x++) {
-            const size_t index = terminal_row * VGA_WIDTH + x;
-            terminal_buffer[index] = terminal_buffer[index + 1];
-        }
-        
+        uint16_t* row = screen_row(terminal_row);
+        memmove(row + terminal_column, row + terminal_column + 1,
+                (VGA_WIDTH - 1 - terminal_column) * sizeof(uint16_t));
+
         // Clear last character in line
-        const size_t last = terminal_row * VGA_WIDTH + (VGA_WIDTH - 1);
-        terminal_buffer[last] = (uint16_t)' ' | (uint16_t)terminal_color << 8;
+        row[VGA_WIDTH - 1] = (uint16_t)' ' | (uint16_t)terminal_color << 8;
+        mark_dirty(terminal_row);
     }
 }
 
 void terminal_clear_line(void) {
     if (terminal_row < VGA_HEIGHT) {
-        for (size_t x = 0; x < VGA_WIDTH; x++) {
-            const size_t index = terminal_row * VGA_WIDTH + x;
-            terminal_buffer[index] = (uint16_t)' ' | (uint16_t)terminal_color << 8;
-        }
+        clear_row(screen_row(terminal_row));
+        mark_dirty(terminal_row);
         terminal_column = 0;
-        update_cursor();
     }
 }
 
+// Same as terminal_put_char; the cursor follows at the next sync point
 void terminal_putchar(char c) {
     terminal_put_char(c);
-    update_cursor();
 } 
\ No newline at end of file
@@ -0,0 +1,307 @@
+#include "include/vmm.h"
+#include "include/pmm.h"
+#include "include/cpu.h"
+#include "include/graphics.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#define PAGE_SIZE 4096
+#define ENTRIES_PER_TABLE 1024
+
+// The page directory maps itself in its last slot, which makes every
+// page table visible at PAGE_TABLES_VIRT once paging is on
+#define RECURSIVE_SLOT 1023
+#define PAGE_TABLES_VIRT 0xFFC00000
+#define PAGE_DIRECTORY_VIRT 0xFFFFF000
+
+// A directory entry with PAGE_LARGE set maps 4 MB directly
+#define LARGE_PAGE_SIZE 0x400000
+#define LARGE_PAGE_MASK (LARGE_PAGE_SIZE - 1)
+
+// Kernel page directory (physical address)
+static uint32_t* page_directory = NULL;
+static bool paging_enabled = false;
+static bool large_pages = false;
+
+// PAGE_GLOBAL when the CPU supports PGE. Every supervisor mapping gets it,
+// so kernel translations survive CR3 reloads.
+static uint32_t global_flag = 0;
+
+// Ranges that are backed on demand
+#define MAX_RESERVATIONS 16
+
+typedef struct {
+    uintptr_t start;
+    uintptr_t end;
+    uint32_t flags;
+    VmmFaultHandler handler;
+} VmmRegion;
+
+static VmmRegion reservations[MAX_RESERVATIONS];
+static size_t reservation_count = 0;
+
+// Mapping statistics
+static size_t large_mappings = 0;
+static size_t small_mappings = 0;
+
+// Present entries in each page table
+static uint16_t table_entries[ENTRIES_PER_TABLE];
+
+// Page directory as seen by the CPU right now
+static uint32_t* current_directory(void) {
+    return paging_enabled ? (uint32_t*)PAGE_DIRECTORY_VIRT : page_directory;
+}
+
+// Page table covering directory slot pdi, which must be present
+static uint32_t* get_page_table(size_t pdi) {
+    if (paging_enabled) {
+        return (uint32_t*)(PAGE_TABLES_VIRT + pdi * PAGE_SIZE);
+    }
+    return (uint32_t*)(page_directory[pdi] & ~0xFFF);
+}
+
+// Map one page, allocating its page table on first use
+bool vmm_map(uintptr_t virt, uintptr_t phys, uint32_t flags) {
+    uint32_t* directory = current_directory();
+    size_t pdi = virt >> 22;
+    size_t pti = (virt >> 12) & 0x3FF;
+
+    if (pdi == RECURSIVE_SLOT || (directory[pdi] & PAGE_LARGE)) return false;
+    if (!(flags & PAGE_USER)) flags |= global_flag;
+
+    if (!(directory[pdi] & PAGE_PRESENT)) {
+        uintptr_t table = alloc_page();
+        if (!table) return false;
+        directory[pdi] = table | PAGE_PRESENT | PAGE_WRITE;
+        memset(get_page_table(pdi), 0, PAGE_SIZE);
+        table_entries[pdi] = 0;
+    }
+
+    uint32_t* table = get_page_table(pdi);
+    if (table[pti] & PAGE_PRESENT) {
+        table[pti] = (phys & ~0xFFF) | (flags & 0xFFF) | PAGE_PRESENT;
+        if (paging_enabled) {
+            tlb_flush_page(virt);
+        }
+    } else {
+        table[pti] = (phys & ~0xFFF) | (flags & 0xFFF) | PAGE_PRESENT;
+        table_entries[pdi]++;
+        small_mappings++;
+    }
+    return true;
+}
+
+// Map a physically contiguous range, using 4 MB pages wherever virt and
+// phys are both 4 MB aligned and a whole large page fits
+bool vmm_map_range(uintptr_t virt, uintptr_t phys, size_t size, uint32_t flags) {
+    uint32_t* directory = current_directory();
+    size_t offset = 0;
+
+    while (offset < size) {
+        uintptr_t v = virt + offset;
+        uintptr_t p = phys + offset;
+        size_t pdi = v >> 22;
+
+        if (large_pages && !(v & LARGE_PAGE_MASK) && !(p & LARGE_PAGE_MASK) &&
+            size - offset >= LARGE_PAGE_SIZE &&
+            pdi != RECURSIVE_SLOT && !(directory[pdi] & PAGE_PRESENT)) {
+            uint32_t global = (flags & PAGE_USER) ? 0 : global_flag;
+            directory[pdi] = p | (flags & 0xFFF) | global | PAGE_LARGE | PAGE_PRESENT;
+            large_mappings++;
+            offset += LARGE_PAGE_SIZE;
+            continue;
+        }
+
+        if (!vmm_map(v, p, flags)) return false;
+        offset += PAGE_SIZE;
+    }
+    return true;
+}
+
+// Unmap one page and return the frame behind it
+uintptr_t vmm_unmap(uintptr_t virt) {
+    uint32_t* directory = current_directory();
+    size_t pdi = virt >> 22;
+    size_t pti = (virt >> 12) & 0x3FF;
+
+    if (pdi == RECURSIVE_SLOT || !(directory[pdi] & PAGE_PRESENT)) return 0;
+
+    // 4 MB mappings are permanent and cannot be split here
+    if (directory[pdi] & PAGE_LARGE) return 0;
+
+    uint32_t* table = get_page_table(pdi);
+    uint32_t entry = table[pti];
+    if (!(entry & PAGE_PRESENT)) return 0;
+
+    table[pti] = 0;
+    small_mappings--;
+
+    // Give the page table back once nothing in its 4 MB region is mapped
+    if (--table_entries[pdi] == 0) {
+        uintptr_t frame = directory[pdi] & ~0xFFF;
+        directory[pdi] = 0;
+        if (paging_enabled) {
+            tlb_flush_page(PAGE_TABLES_VIRT + pdi * PAGE_SIZE);
+        }
+        free_page(frame);
+    }
+
+    return entry & ~0xFFF;
+}
+
+// Change the caching bits of every entry covering [virt, virt + size)
+bool vmm_set_cache(uintptr_t virt, size_t size, uint32_t cache) {
+    uint32_t* directory = current_directory();
+    const uint32_t cache_bits = PAGE_WRITE_THROUGH | PAGE_CACHE_DISABLE;
+    uintptr_t first = virt & ~0xFFF;
+    uintptr_t addr = first;
+    size_t pages = 0;
+
+    cache &= cache_bits;
+    while (addr - first < size + (virt - first)) {
+        size_t pdi = addr >> 22;
+        if (pdi == RECURSIVE_SLOT || !(directory[pdi] & PAGE_PRESENT)) return false;
+
+        if (directory[pdi] & PAGE_LARGE) {
+            directory[pdi] = (directory[pdi] & ~cache_bits) | cache;
+            uintptr_t next = (addr & ~LARGE_PAGE_MASK) + LARGE_PAGE_SIZE;
+            pages += (next - addr) / PAGE_SIZE;
+            addr = next;
+            continue;
+        }
+
+        uint32_t* table = get_page_table(pdi);
+        size_t pti = (addr >> 12) & 0x3FF;
+        if (!(table[pti] & PAGE_PRESENT)) return false;
+        table[pti] = (table[pti] & ~cache_bits) | cache;
+        pages++;
+        addr += PAGE_SIZE;
+    }
+
+    if (paging_enabled) {
+        tlb_flush_range(first, pages);
+    }
+    return true;
+}
+
+// Translate a virtual address through the current page tables
+uintptr_t vmm_translate(uintptr_t virt) {
+    uint32_t* directory = current_directory();
+    size_t pdi = virt >> 22;
+    size_t pti = (virt >> 12) & 0x3FF;
+
+    if (!(directory[pdi] & PAGE_PRESENT)) return 0;
+
+    if (directory[pdi] & PAGE_LARGE) {
+        return (directory[pdi] & ~LARGE_PAGE_MASK) | (virt & LARGE_PAGE_MASK);
+    }
+
+    uint32_t entry = get_page_table(pdi)[pti];
+    if (!(entry & PAGE_PRESENT)) return 0;
+
+    return (entry & ~0xFFF) | (virt & 0xFFF);
+}
+
+// Build the kernel page directory and turn paging on
+bool vmm_init(void) {
+    // Allocate page directory
+    page_directory = (uint32_t*)alloc_page();
+    if (!page_directory) return false;
+    memset(page_directory, 0, PAGE_SIZE);
+    memset(table_entries, 0, sizeof(table_entries));
+    page_directory[RECURSIVE_SLOT] = ((uintptr_t)page_directory) | PAGE_PRESENT | PAGE_WRITE;
+
+    // cpu_init turns on CR4.PSE when the CPU has it
+    large_pages = cpu_has_feature(CPU_FEATURE_PSE);
+    if (cpu_has_feature(CPU_FEATURE_PGE)) {
+        global_flag = PAGE_GLOBAL;
+    }
+
+    // Identity map low memory, the kernel image and the frame descriptors.
+    // With 4 MB pages the whole range is covered, rounded up to a large
+    // page. Without them page 0 stays unmapped so that NULL dereferences
+    // fault.
+    uintptr_t identity_end = (uintptr_t)&end;
+    if (pmm_metadata_end() > identity_end) {
+        identity_end = pmm_metadata_end();
+    }
+    if (large_pages) {
+        identity_end = (identity_end + LARGE_PAGE_MASK) & ~LARGE_PAGE_MASK;
+        if (!vmm_map_range(0, 0, identity_end, PAGE_WRITE)) return false;
+    } else {
+        if (!vmm_map_range(PAGE_SIZE, PAGE_SIZE, identity_end - PAGE_SIZE, PAGE_WRITE)) {
+            return false;
+        }
+    }
+
+    // Identity map the linear framebuffer
+    if (!vmm_map_range(GRAPHICS_LFB_ADDRESS, GRAPHICS_LFB_ADDRESS, GRAPHICS_LFB_SIZE, PAGE_WRITE)) {
+        return false;
+    }
+
+    // Enable paging
+    enable_paging(page_directory);
+    paging_enabled = true;
+    return true;
+}
+
+// Reserve a range for demand paging
+bool vmm_reserve(uintptr_t virt, size_t size, uint32_t flags, VmmFaultHandler handler) {
+    if (reservation_count >= MAX_RESERVATIONS || size == 0) return false;
+
+    VmmRegion* region = &reservations[reservation_count++];
+    region->start = virt & ~0xFFF;
+    region->end = virt + size;
+    region->flags = flags;
+    region->handler = handler;
+    return true;
+}
+
+// Reservation covering addr, if any
+static const VmmRegion* find_reservation(uintptr_t addr) {
+    for (size_t i = 0; i < reservation_count; i++) {
+        if (addr >= reservations[i].start && addr < reservations[i].end) {
+            return &reservations[i];
+        }
+    }
+    return NULL;
+}
+
+// Check whether addr is reserved
+bool vmm_is_reserved(uintptr_t addr) {
+    return find_reservation(addr) != NULL;
+}
+
+// Back the faulting page of a reserved range
+bool vmm_handle_fault(uintptr_t addr, uint32_t error) {
+    // Protection faults and corrupted tables are never first touches
+    if (error & (PF_PRESENT | PF_RESERVED)) return false;
+
+    const VmmRegion* region = find_reservation(addr);
+    if (!region) return false;
+
+    if (region->handler) {
+        return region->handler(addr);
+    }
+
+    uintptr_t page = addr & ~0xFFF;
+    uintptr_t frame = alloc_page();
+    if (!frame) return false;
+    if (!vmm_map(page, frame, region->flags)) {
+        free_page(frame);
+        return false;
+    }
+    memset((void*)page, 0, PAGE_SIZE);
+    return true;
+}
+
+// Number of live 4 MB mappings
+size_t vmm_large_mappings(void) {
+    return large_mappings;
+}
+
+// Number of live 4 KB mappings
+size_t vmm_small_mappings(void) {
+    return small_mappings;
+}
@@ -1,25 +1,51 @@
 #include <stdlib.h>
+#include <stdbool.h>
+
+// Parse an optionally signed decimal number after leading white space
+static long long parse_decimal(const char* str) {
+    unsigned long long result = 0;
+    bool negative = false;
+
+    while (*str == ' ' || (*str >= '\t' && *str <= '\r')) {
+        str++;
+    }
 
-int atoi(const char* str) {
-    int result = 0;
-    int sign = 1;
-    
-    // Skip whitespace
-    while (*str == ' ' || *str == '\t') str++;
-    
-    // Handle sign
     if (*str == '-') {
-        sign = -1;
+        negative = true;
         str++;
     } else if (*str == '+') {
         str++;
     }
-    
-    // Convert digits
+
     while (*str >= '0' && *str <= '9') {
-        result = result * 10 + (*str - '0');
+        result = result * 10 + (unsigned long long)(*str - '0');
         str++;
     }
-    
-    return sign * result;
-} 
\ No newline at end of file
+
+    return negative ? -(long long)result : (long long)result;
+}
+
+// String conversion
+int atoi(const char* str) {
+    return (int)parse_decimal(str);
+}
+
+long atol(const char* str) {
+    return (long)parse_decimal(str);
+}
+
+long long atoll(const char* str) {
+    return parse_decimal(str);
+}
+
+// Random numbers
+static unsigned int rand_seed = 1;
+
+int rand(void) {
+    rand_seed = rand_seed * 1103515245 + 12345;
+    return (int)(rand_seed >> 16) & 0x7fff;
+}
+
+void srand(unsigned int seed) {
+    rand_seed = seed;
+}
@@ -1,99 +1,513 @@
-#include <stddef.h>
 #include <string.h>
+#include "cpu.h"
+#include "fpu.h"
+#include "../include/config.h"
 #include <stdint.h>
+#include <stdbool.h>
 
-size_t strlen(const char* str) {
-    size_t len = 0;
-    while (str[len]) len++;
-    return len;
+// memcpy, memset and memset32 come in several variants; string_init
+// points the dispatch pointers at the best one for this CPU. Until then
+// the rep movsd/stosd versions, which work everywhere, are used.
+
+static bool have_erms = false;
+static bool have_sse = false;
+
+// Copy with rep movsd, then the odd bytes with rep movsb
+static inline void copy_rep(void* dest, const void* src, size_t count) {
+    size_t dwords = count >> 2;
+    __asm__ __volatile__("rep movsl\n\t"
+                         "movl %k3, %%ecx\n\t"
+                         "rep movsb"
+                         : "+D" (dest), "+S" (src), "+c" (dwords)
+                         : "r" (count & 3)
+                         : "memory");
+}
+
+// Copy with rep movsb, which ERMS CPUs run at full line width
+static inline void copy_erms(void* dest, const void* src, size_t count) {
+    __asm__ __volatile__("rep movsb"
+                         : "+D" (dest), "+S" (src), "+c" (count)
+                         :
+                         : "memory");
+}
+
+// Fill count dwords with rep stosd
+static inline void fill_rep(void* dest, uint32_t pattern, size_t dwords) {
+    __asm__ __volatile__("rep stosl"
+                         : "+D" (dest), "+c" (dwords)
+                         : "a" (pattern)
+                         : "memory");
+}
+
+// Fill count bytes with rep stosb
+static inline void fill_erms(void* dest, uint8_t val, size_t count) {
+    __asm__ __volatile__("rep stosb"
+                         : "+D" (dest), "+c" (count)
+                         : "a" (val)
+                         : "memory");
+}
+
+static inline void copy_small(void* dest, const void* src, size_t count) {
+    if (have_erms) {
+        copy_erms(dest, src, count);
+    } else {
+        copy_rep(dest, src, count);
+    }
+}
+
+// Source words may sit at any alignment
+typedef uint32_t __attribute__((may_alias, aligned(1))) unaligned_u32;
+
+// Store a dword around the caches (SSE2 MOVNTI)
+static inline void store_nt(uint32_t* dest, uint32_t value) {
+    __asm__ __volatile__("movnti %1, %0" : "=m" (*dest) : "r" (value));
+}
+
+// Order the non-temporal stores before anything that follows
+static inline void store_fence(void) {
+    __asm__ __volatile__("sfence" : : : "memory");
+}
+
+// Copy 64-byte blocks to a 16-byte aligned destination with MOVNTDQ.
+// Must run inside a kernel FPU section.
+static void copy_nt_sse(uint8_t* dest, const uint8_t* src, size_t blocks) {
+    __asm__ __volatile__("1:\n\t"
+                         "movdqu (%1), %%xmm0\n\t"
+                         "movdqu 16(%1), %%xmm1\n\t"
+                         "movdqu 32(%1), %%xmm2\n\t"
+                         "movdqu 48(%1), %%xmm3\n\t"
+                         "movntdq %%xmm0, (%0)\n\t"
+                         "movntdq %%xmm1, 16(%0)\n\t"
+                         "movntdq %%xmm2, 32(%0)\n\t"
+                         "movntdq %%xmm3, 48(%0)\n\t"
+                         "add $64, %0\n\t"
+                         "add $64, %1\n\t"
+                         "dec %2\n\t"
+                         "jnz 1b\n\t"
+                         "sfence"
+                         : "+r" (dest), "+r" (src), "+r" (blocks)
+                         :
+                         : "memory");
+}
+
+// Fill 64-byte blocks at a 16-byte aligned destination with MOVNTDQ.
+// Must run inside a kernel FPU section.
+static void fill_nt_sse(uint8_t* dest, uint32_t pattern, size_t blocks) {
+    __asm__ __volatile__("movd %2, %%xmm0\n\t"
+                         "pshufd $0, %%xmm0, %%xmm0\n\t"
+                         "1:\n\t"
+                         "movntdq %%xmm0, (%0)\n\t"
+                         "movntdq %%xmm0, 16(%0)\n\t"
+                         "movntdq %%xmm0, 32(%0)\n\t"
+                         "movntdq %%xmm0, 48(%0)\n\t"
+                         "add $64, %0\n\t"
+                         "dec %1\n\t"
+                         "jnz 1b\n\t"
+                         "sfence"
+                         : "+r" (dest), "+r" (blocks)
+                         : "r" (pattern)
+                         : "memory");
+}
+
+// Whether the XMM registers may be used for this call
+static inline bool sse_usable(size_t blocks) {
+    return have_sse && blocks && kernel_fpu_usable();
+}
+
+// Copy a 16-byte aligned destination with non-temporal stores. Buffers
+// this large would only push everything else out of the cache. Whole
+// 64-byte blocks go through SSE when a kernel FPU section can be opened,
+// the rest through MOVNTI.
+static void copy_nt(uint8_t* dest, const uint8_t* src, size_t count) {
+    size_t head = (16 - ((uintptr_t)dest & 15)) & 15;
+    copy_small(dest, src, head);
+    dest += head;
+    src += head;
+    count -= head;
+
+    size_t blocks = count / 64;
+    if (sse_usable(blocks)) {
+        kernel_fpu_begin();
+        copy_nt_sse(dest, src, blocks);
+        kernel_fpu_end();
+        dest += blocks * 64;
+        src += blocks * 64;
+        count -= blocks * 64;
+    }
+
+    uint32_t* d = (uint32_t*)dest;
+    const unaligned_u32* s = (const unaligned_u32*)src;
+    for (; count >= 16; count -= 16, d += 4, s += 4) {
+        uint32_t a = s[0], b = s[1], c = s[2], e = s[3];
+        store_nt(d, a);
+        store_nt(d + 1, b);
+        store_nt(d + 2, c);
+        store_nt(d + 3, e);
+    }
+    store_fence();
+    copy_small(d, s, count);
 }
 
-void* memcpy(void* dest, const void* src, size_t n) {
-    unsigned char* d = dest;
-    const unsigned char* s = src;
-    while (n--) *d++ = *s++;
+// Fill with non-temporal stores, dword pattern included
+static void fill_nt(uint8_t* dest, uint32_t pattern, size_t count) {
+    // Bring dest to a 16-byte boundary, keeping the pattern in phase
+    while (((uintptr_t)dest & 15) && count) {
+        *dest++ = (uint8_t)pattern;
+        pattern = (pattern >> 8) | (pattern << 24);
+        count--;
+    }
+
+    size_t blocks = count / 64;
+    if (sse_usable(blocks)) {
+        kernel_fpu_begin();
+        fill_nt_sse(dest, pattern, blocks);
+        kernel_fpu_end();
+        dest += blocks * 64;
+        count -= blocks * 64;
+    }
+
+    uint32_t* d = (uint32_t*)dest;
+    for (; count >= 16; count -= 16, d += 4) {
+        store_nt(d, pattern);
+        store_nt(d + 1, pattern);
+        store_nt(d + 2, pattern);
+        store_nt(d + 3, pattern);
+    }
+    store_fence();
+
+    dest = (uint8_t*)d;
+    while (count--) {
+        *dest++ = (uint8_t)pattern;
+        pattern = (pattern >> 8) | (pattern << 24);
+    }
+}
+
+static void* memcpy_rep(void* dest, const void* src, size_t count) {
+    copy_rep(dest, src, count);
+    return dest;
+}
+
+static void* memcpy_erms(void* dest, const void* src, size_t count) {
+    copy_erms(dest, src, count);
     return dest;
 }
 
-void* memmove(void* dest, const void* src, size_t n) {
-    unsigned char* d = dest;
-    const unsigned char* s = src;
-    
-    if (d < s) {
-        while (n--) *d++ = *s++;
+static void* memcpy_sse2(void* dest, const void* src, size_t count) {
+    if (count >= CONFIG_STRING_NT_THRESHOLD) {
+        copy_nt(dest, src, count);
     } else {
-        d += n;
-        s += n;
-        while (n--) *--d = *--s;
+        copy_small(dest, src, count);
     }
-    
     return dest;
 }
 
-int strcmp(const char* s1, const char* s2) {
-    while (*s1 && (*s1 == *s2)) {
-        s1++;
-        s2++;
+static void* memset_rep(void* dest, int val, size_t count) {
+    uint32_t pattern = (uint8_t)val * 0x01010101u;
+    fill_rep(dest, pattern, count >> 2);
+    fill_erms((uint8_t*)dest + (count & ~(size_t)3), (uint8_t)val, count & 3);
+    return dest;
+}
+
+static void* memset_erms(void* dest, int val, size_t count) {
+    fill_erms(dest, (uint8_t)val, count);
+    return dest;
+}
+
+static void* memset_sse2(void* dest, int val, size_t count) {
+    if (count >= CONFIG_STRING_NT_THRESHOLD) {
+        fill_nt(dest, (uint8_t)val * 0x01010101u, count);
+        return dest;
     }
-    return *(unsigned char*)s1 - *(unsigned char*)s2;
+    return have_erms ? memset_erms(dest, val, count) : memset_rep(dest, val, count);
+}
+
+static void memset32_rep(uint32_t* dest, uint32_t value, size_t count) {
+    fill_rep(dest, value, count);
+}
+
+static void memset32_sse2(uint32_t* dest, uint32_t value, size_t count) {
+    if (count * sizeof(uint32_t) >= CONFIG_STRING_NT_THRESHOLD && !((uintptr_t)dest & 3)) {
+        fill_nt((uint8_t*)dest, value, count * sizeof(uint32_t));
+    } else {
+        fill_rep(dest, value, count);
+    }
+}
+
+static void* (*memcpy_fn)(void*, const void*, size_t) = memcpy_rep;
+static void* (*memset_fn)(void*, int, size_t) = memset_rep;
+static void (*memset32_fn)(uint32_t*, uint32_t, size_t) = memset32_rep;
+
+// Pick the memcpy/memset variants for this CPU
+void string_init(void) {
+    have_erms = cpu_has_extended_feature(CPU_FEATURE_EXT_ERMS);
+    have_sse = fpu_sse_enabled() && cpu_has_feature(CPU_FEATURE_SSE2);
+
+    if (cpu_has_feature(CPU_FEATURE_SSE2)) {
+        memcpy_fn = memcpy_sse2;
+        memset_fn = memset_sse2;
+        memset32_fn = memset32_sse2;
+    } else if (have_erms) {
+        memcpy_fn = memcpy_erms;
+        memset_fn = memset_erms;
+    }
+}
+
+void* memset(void* dest, int val, size_t count) {
+    return memset_fn(dest, val, count);
+}
+
+void* memcpy(void* dest, const void* src, size_t count) {
+    return memcpy_fn(dest, src, count);
+}
+
+// Copies that overlap with dest above src run backwards
+void* memmove(void* dest, const void* src, size_t count) {
+    uintptr_t d = (uintptr_t)dest;
+    uintptr_t s = (uintptr_t)src;
+
+    if (d - s >= count) {
+        // dest below src, or no overlap: a forward copy is safe. The
+        // non-temporal path is left out because it reorders stores.
+        copy_rep(dest, src, count);
+        return dest;
+    }
+
+    // Copy backwards a word at a time. Each store lands above everything
+    // still to be read, so this holds for any overlap. Backward string
+    // instructions never take the fast path, hence the plain loop.
+    const uint8_t* from = (const uint8_t*)src + count;
+    uint8_t* to = (uint8_t*)dest + count;
+    while (count >= 4) {
+        from -= 4;
+        to -= 4;
+        *(unaligned_u32*)to = *(const unaligned_u32*)from;
+        count -= 4;
+    }
+    while (count-- > 0) {
+        *--to = *--from;
+    }
+    return dest;
+}
+
+void memset32(uint32_t* dest, uint32_t value, size_t count) {
+    memset32_fn(dest, value, count);
+}
+
+// Word-at-a-time scanning. A word has a zero byte exactly when
+// (w - 0x01010101) & ~w & 0x80808080 is non-zero. Aligned 4-byte loads
+// never straddle a page boundary, so reading the rest of the word that
+// holds a terminator is safe.
+#define BYTES_ONE  0x01010101u
+#define BYTES_HIGH 0x80808080u
+
+// memcmp hands lengths from here up to SSE2, where the FPU section pays off
+#define MEMCMP_SSE_MIN 512
+
+typedef uint32_t __attribute__((may_alias)) word_t;
+
+static inline uint32_t has_zero(uint32_t word) {
+    return (word - BYTES_ONE) & ~word & BYTES_HIGH;
+}
+
+// Offset of the first 16-byte block that differs, or blocks * 16.
+// Must run inside a kernel FPU section.
+static size_t compare_sse(const uint8_t* p1, const uint8_t* p2, size_t blocks) {
+    size_t offset = 0;
+    for (; blocks > 0; blocks--, offset += 16) {
+        uint32_t mask;
+        __asm__ __volatile__("movdqu (%1), %%xmm0\n\t"
+                             "movdqu (%2), %%xmm1\n\t"
+                             "pcmpeqb %%xmm1, %%xmm0\n\t"
+                             "pmovmskb %%xmm0, %0"
+                             : "=r" (mask)
+                             : "r" (p1 + offset), "r" (p2 + offset)
+                             : "memory");
+        if (mask != 0xFFFF) break;
+    }
+    return offset;
+}
+
+int memcmp(const void* ptr1, const void* ptr2, size_t count) {
+    const unsigned char* p1 = (const unsigned char*)ptr1;
+    const unsigned char* p2 = (const unsigned char*)ptr2;
+
+    // Skip the equal prefix 16 or 4 bytes at a time; the loads stay
+    // inside both buffers, so they need no alignment
+    if (have_sse && count >= MEMCMP_SSE_MIN && kernel_fpu_usable()) {
+        kernel_fpu_begin();
+        size_t same = compare_sse(p1, p2, count / 16);
+        kernel_fpu_end();
+        p1 += same;
+        p2 += same;
+        count -= same;
+    }
+    while (count >= 4 && *(const unaligned_u32*)p1 == *(const unaligned_u32*)p2) {
+        p1 += 4;
+        p2 += 4;
+        count -= 4;
+    }
+
+    while (count-- > 0) {
+        if (*p1++ != *p2++) {
+            return p1[-1] < p2[-1] ? -1 : 1;
+        }
+    }
+    return 0;
 }
 
 char* strcpy(char* dest, const char* src) {
+    return memcpy(dest, src, strlen(src) + 1);
+}
+
+char* strncpy(char* dest, const char* src, size_t count) {
     char* d = dest;
-    while ((*d++ = *src++));
+    while (count-- > 0) {
+        if ((*d++ = *src++) == '\0') {
+            while (count-- > 0) {
+                *d++ = '\0';
+            }
+            break;
+        }
+    }
+    return dest;
+}
+
+char* strcat(char* dest, const char* src) {
+    strcpy(dest + strlen(dest), src);
     return dest;
 }
 
-char* strncpy(char* dest, const char* src, size_t n) {
-    size_t i;
-    
-    for (i = 0; i < n && src[i] != '\0'; i++)
-        dest[i] = src[i];
-    for ( ; i < n; i++)
-        dest[i] = '\0';
-        
+char* strncat(char* dest, const char* src, size_t count) {
+    char* d = dest;
+    while (*d) d++;
+    while (count-- > 0) {
+        if ((*d++ = *src++) == '\0') {
+            return dest;
+        }
+    }
+    *d = '\0';
     return dest;
 }
 
-int memcmp(const void* s1, const void* s2, size_t n) {
-    const unsigned char* p1 = s1;
-    const unsigned char* p2 = s2;
-    
-    while (n--) {
-        if (*p1 != *p2)
-            return *p1 - *p2;
-        p1++;
-        p2++;
+int strcmp(const char* str1, const char* str2) {
+    // Words can only be compared when both strings share an alignment
+    if ((((uintptr_t)str1 ^ (uintptr_t)str2) & 3) == 0) {
+        while ((uintptr_t)str1 & 3) {
+            if (!*str1 || *str1 != *str2) {
+                return *(unsigned char*)str1 - *(unsigned char*)str2;
+            }
+            str1++;
+            str2++;
+        }
+
+        const word_t* w1 = (const word_t*)str1;
+        const word_t* w2 = (const word_t*)str2;
+        while (*w1 == *w2 && !has_zero(*w1)) {
+            w1++;
+            w2++;
+        }
+        str1 = (const char*)w1;
+        str2 = (const char*)w2;
+    }
+
+    while (*str1 && (*str1 == *str2)) {
+        str1++;
+        str2++;
+    }
+    return *(unsigned char*)str1 - *(unsigned char*)str2;
+}
+
+int strncmp(const char* str1, const char* str2, size_t count) {
+    // Same word loop as strcmp, stopping short of the count
+    if ((((uintptr_t)str1 ^ (uintptr_t)str2) & 3) == 0) {
+        while (count > 0 && ((uintptr_t)str1 & 3)) {
+            if (!*str1 || *str1 != *str2) {
+                return *(unsigned char*)str1 - *(unsigned char*)str2;
+            }
+            str1++;
+            str2++;
+            count--;
+        }
+
+        const word_t* w1 = (const word_t*)str1;
+        const word_t* w2 = (const word_t*)str2;
+        while (count >= 4 && *w1 == *w2 && !has_zero(*w1)) {
+            w1++;
+            w2++;
+            count -= 4;
+        }
+        str1 = (const char*)w1;
+        str2 = (const char*)w2;
+    }
+
+    while (count-- > 0) {
+        if (*str1 != *str2) {
+            return *(unsigned char*)str1 - *(unsigned char*)str2;
+        }
+        if (*str1 == '\0') {
+            return 0;
+        }
+        str1++;
+        str2++;
     }
     return 0;
 }
 
-void* memset(void* s, int c, size_t n) {
-    unsigned char* p = s;
-    while (n--) *p++ = (unsigned char)c;
-    return s;
+size_t strlen(const char* str) {
+    const char* s = str;
+    while ((uintptr_t)s & 3) {
+        if (!*s) return s - str;
+        s++;
+    }
+
+    const word_t* w = (const word_t*)s;
+    while (!has_zero(*w)) w++;
+
+    s = (const char*)w;
+    while (*s) s++;
+    return s - str;
 }
 
-int atoi(const char* str) {
-    int result = 0;
-    int sign = 1;
-    
-    // Skip whitespace
-    while (*str == ' ' || *str == '\t') str++;
-    
-    // Handle sign
-    if (*str == '-') {
-        sign = -1;
-        str++;
-    } else if (*str == '+') {
+char* strchr(const char* str, int ch) {
+    char c = (char)ch;
+    while ((uintptr_t)str & 3) {
+        if (*str == c) return (char*)str;
+        if (!*str) return NULL;
         str++;
     }
-    
-    // Convert digits
-    while (*str >= '0' && *str <= '9') {
-        result = result * 10 + (*str - '0');
-        str++;
+
+    // Stop at the first word holding either the terminator or c
+    uint32_t pattern = (uint8_t)c * BYTES_ONE;
+    const word_t* w = (const word_t*)str;
+    while (!has_zero(*w) && !has_zero(*w ^ pattern)) w++;
+
+    for (str = (const char*)w; ; str++) {
+        if (*str == c) return (char*)str;
+        if (!*str) return NULL;
+    }
+}
+
+char* strrchr(const char* str, int ch) {
+    const char* last = NULL;
+    do {
+        if (*str == (char)ch) {
+            last = str;
+        }
+    } while (*str++);
+    return (char*)last;
+}
+
+char* strstr(const char* str1, const char* str2) {
+    if (!*str2) return (char*)str1;
+    while (*str1) {
+        const char* s1 = str1;
+        const char* s2 = str2;
+        while (*s1 && *s2 && *s1 == *s2) {
+            s1++;
+            s2++;
+        }
+        if (!*s2) return (char*)str1;
+        str1++;
     }
-    
-    return result * sign;
+    return NULL;
 } 
\ No newline at end of file
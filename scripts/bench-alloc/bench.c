@@ -0,0 +1,393 @@
+// Host-side benchmark for the kernel heap (kernel/memory.c).
+//
+// Replays allocation traces against the real allocator and reports the
+// time per operation, the peak number of frames behind the heap compared
+// to the bytes the trace had live, and free-space fragmentation.
+//
+// Usage: bench-alloc [-r runs] [trace...]
+//
+// Without trace files the built-in synthetic traces are replayed. A
+// recorded trace is a text file with one operation per line:
+//
+//   a <id> <size>    kmalloc, the result is remembered as <id>
+//   c <id> <size>    kcalloc(1, size)
+//   r <id> <size>    krealloc of <id>
+//   f <id>           kfree of <id>
+//
+// Blank lines and lines starting with '#' are ignored.
+//
+// Lazily backed heap pages are faulted in through SIGSEGV here, which is
+// far slower than a #PF in the kernel; the faults column shows how much
+// of a trace's time that accounts for.
+#define _GNU_SOURCE
+#include "memory.h"
+#include "shim.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Fragmentation is sampled this often during the measuring pass
+#define SAMPLE_INTERVAL 1024
+
+typedef struct {
+    char op;
+    uint32_t id;
+    uint32_t size;
+} TraceOp;
+
+typedef struct {
+    const char* name;
+    TraceOp* ops;
+    size_t count;
+    size_t capacity;
+    uint32_t ids;           // One more than the largest id used
+} Trace;
+
+typedef struct {
+    double ns_per_op;
+    size_t peak_live;       // Most bytes the trace had live at once
+    size_t peak_frames;     // Most frames behind the heap at once
+    size_t faults;
+    size_t failures;
+    unsigned int peak_fragmentation;
+    unsigned int end_fragmentation;
+    size_t end_free_runs;
+} TraceResult;
+
+static void trace_push(Trace* trace, char op, uint32_t id, uint32_t size) {
+    if (trace->count == trace->capacity) {
+        trace->capacity = trace->capacity ? trace->capacity * 2 : 4096;
+        trace->ops = realloc(trace->ops, trace->capacity * sizeof(TraceOp));
+        if (!trace->ops) {
+            perror("bench-alloc");
+            exit(1);
+        }
+    }
+    trace->ops[trace->count++] = (TraceOp){ op, id, size };
+    if (id >= trace->ids) {
+        trace->ids = id + 1;
+    }
+}
+
+// Deterministic generator so that runs are comparable
+static uint32_t rng_state;
+
+static uint32_t rng(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+static uint32_t rng_range(uint32_t lo, uint32_t hi) {
+    return lo + rng() % (hi - lo + 1);
+}
+
+// Ids that are currently allocated, so frees can pick one at random
+typedef struct {
+    uint32_t* ids;
+    size_t count;
+    uint32_t next;
+} LiveSet;
+
+static void live_add(LiveSet* live, Trace* trace, char op, uint32_t size) {
+    uint32_t id = live->next++;
+    live->ids = realloc(live->ids, live->next * sizeof(uint32_t));
+    live->ids[live->count++] = id;
+    trace_push(trace, op, id, size);
+}
+
+static uint32_t live_take(LiveSet* live, size_t index) {
+    uint32_t id = live->ids[index];
+    live->ids[index] = live->ids[--live->count];
+    return id;
+}
+
+// Mostly small objects with a tail of page-sized and larger ones, around
+// a steady live set, with the occasional resize
+static void gen_mixed(Trace* trace) {
+    LiveSet live = { NULL, 0, 0 };
+    rng_state = 0x12345678;
+    trace->name = "mixed";
+
+    for (int i = 0; i < 200000; i++) {
+        uint32_t pick = rng() % 100;
+        uint32_t size;
+        if (pick < 70) size = rng_range(8, 256);
+        else if (pick < 95) size = rng_range(257, 4096);
+        else size = rng_range(4097, 65536);
+
+        bool grow = live.count < 2000 || rng() % 2;
+        if (live.count && rng() % 20 == 0) {
+            trace_push(trace, 'r', live.ids[rng() % live.count], size);
+        } else if (grow || !live.count) {
+            live_add(&live, trace, rng() % 8 ? 'a' : 'c', size);
+        } else {
+            trace_push(trace, 'f', live_take(&live, rng() % live.count), 0);
+        }
+    }
+    while (live.count) {
+        trace_push(trace, 'f', live_take(&live, live.count - 1), 0);
+    }
+    free(live.ids);
+}
+
+// Windows being opened, resized and closed: bursts of framebuffer-sized
+// back buffers mixed with the small objects that go with each window
+static void gen_windows(Trace* trace) {
+    LiveSet windows = { NULL, 0, 0 };
+    LiveSet small = { NULL, 0, 1u << 24 };
+    rng_state = 0x9E3779B9;
+    trace->name = "windows";
+
+    for (int burst = 0; burst < 300; burst++) {
+        uint32_t opened = rng_range(2, 6);
+        for (uint32_t i = 0; i < opened; i++) {
+            uint32_t width = rng_range(160, 800);
+            uint32_t height = rng_range(120, 600);
+            live_add(&windows, trace, 'c', width * height * 4);
+            for (uint32_t j = rng_range(10, 40); j > 0; j--) {
+                live_add(&small, trace, 'a', rng_range(16, 512));
+            }
+        }
+        if (windows.count && rng() % 3 == 0) {
+            uint32_t width = rng_range(160, 1024);
+            uint32_t height = rng_range(120, 768);
+            trace_push(trace, 'r', windows.ids[rng() % windows.count], width * height * 4);
+        }
+        while (windows.count > 8) {
+            trace_push(trace, 'f', live_take(&windows, rng() % windows.count), 0);
+        }
+        while (small.count > 200) {
+            trace_push(trace, 'f', live_take(&small, rng() % small.count), 0);
+        }
+    }
+    while (windows.count) {
+        trace_push(trace, 'f', live_take(&windows, windows.count - 1), 0);
+    }
+    while (small.count) {
+        trace_push(trace, 'f', live_take(&small, small.count - 1), 0);
+    }
+    free(windows.ids);
+    free(small.ids);
+}
+
+// Packet buffers going through a queue whose depth rises and falls, freed
+// in arrival order
+static void gen_packets(Trace* trace) {
+    enum { QUEUE = 512 };
+    uint32_t queue[QUEUE];
+    size_t head = 0, tail = 0;
+    uint32_t next = 0;
+    rng_state = 0xC0FFEE11;
+    trace->name = "packets";
+
+    for (int i = 0; i < 300000; i++) {
+        size_t depth = tail - head;
+        size_t target = (i >> 10) & 1 ? 255 : 1;
+        bool enqueue = depth == 0 || (depth < QUEUE && (depth < target ? rng() % 4 != 0 : rng() % 4 == 0));
+
+        if (enqueue) {
+            uint32_t pick = rng() % 10;
+            uint32_t size = pick < 5 ? rng_range(64, 128) : pick < 9 ? 1518 : rng_range(129, 1517);
+            queue[tail++ % QUEUE] = next;
+            trace_push(trace, 'a', next++, size + 66);
+        } else {
+            trace_push(trace, 'f', queue[head++ % QUEUE], 0);
+        }
+    }
+    while (head != tail) {
+        trace_push(trace, 'f', queue[head++ % QUEUE], 0);
+    }
+}
+
+// Read a recorded trace
+static bool load_trace(Trace* trace, const char* path) {
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        perror(path);
+        return false;
+    }
+
+    char line[128];
+    unsigned long lineno = 0;
+    trace->name = path;
+    while (fgets(line, sizeof(line), file)) {
+        char op;
+        unsigned long id, size = 0;
+        lineno++;
+        if (line[0] == '#' || line[0] == '\n') continue;
+
+        int fields = sscanf(line, " %c %lu %lu", &op, &id, &size);
+        bool ok = (op == 'f' && fields >= 2) ||
+                  ((op == 'a' || op == 'c' || op == 'r') && fields == 3);
+        if (!ok || id >= UINT32_MAX || size > UINT32_MAX) {
+            fprintf(stderr, "%s:%lu: bad trace line\n", path, lineno);
+            fclose(file);
+            return false;
+        }
+        trace_push(trace, op, (uint32_t)id, (uint32_t)size);
+    }
+    fclose(file);
+    return true;
+}
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// Write one byte per page, the way a caller filling its buffer would,
+// so that lazily backed pages are counted
+static void touch(uint8_t* ptr, uint32_t size) {
+    for (uint32_t offset = 0; offset < size; offset += PAGE_SIZE) {
+        ptr[offset] = 1;
+    }
+    if (size) {
+        ptr[size - 1] = 1;
+    }
+}
+
+// Replay a trace once on a fresh heap. With sample set, fragmentation
+// is recorded along the way (and the timing is not meaningful).
+static double replay(const Trace* trace, TraceResult* result, bool sample) {
+    uint8_t** slots = calloc(trace->ids, sizeof(uint8_t*));
+    uint32_t* sizes = calloc(trace->ids, sizeof(uint32_t));
+    size_t live = 0;
+
+    memory_init();
+    result->peak_live = 0;
+    result->failures = 0;
+    result->peak_fragmentation = 0;
+
+    uint64_t start = now_ns();
+    for (size_t i = 0; i < trace->count; i++) {
+        const TraceOp* op = &trace->ops[i];
+        uint8_t* ptr;
+
+        switch (op->op) {
+        case 'a':
+        case 'c':
+            ptr = op->op == 'a' ? kmalloc(op->size) : kcalloc(1, op->size);
+            if (!ptr) {
+                result->failures++;
+                break;
+            }
+            kfree(slots[op->id]);
+            live -= slots[op->id] ? sizes[op->id] : 0;
+            touch(ptr, op->size);
+            slots[op->id] = ptr;
+            sizes[op->id] = op->size;
+            live += op->size;
+            break;
+        case 'r':
+            ptr = krealloc(slots[op->id], op->size);
+            if (!ptr && op->size) {
+                result->failures++;
+                break;
+            }
+            live -= slots[op->id] ? sizes[op->id] : 0;
+            touch(ptr, op->size);
+            slots[op->id] = ptr;
+            sizes[op->id] = op->size;
+            live += op->size;
+            break;
+        case 'f':
+            if (slots[op->id]) {
+                kfree(slots[op->id]);
+                live -= sizes[op->id];
+                slots[op->id] = NULL;
+            }
+            break;
+        }
+
+        if (live > result->peak_live) {
+            result->peak_live = live;
+        }
+        if (sample && i % SAMPLE_INTERVAL == 0) {
+            KheapStats stats;
+            kheap_get_stats(&stats);
+            if (stats.fragmentation > result->peak_fragmentation) {
+                result->peak_fragmentation = stats.fragmentation;
+            }
+        }
+    }
+    uint64_t elapsed = now_ns() - start;
+
+    KheapStats stats;
+    kheap_get_stats(&stats);
+    result->end_fragmentation = stats.fragmentation;
+    result->end_free_runs = stats.free_runs;
+    result->peak_frames = shim_frames_peak();
+    result->faults = shim_faults();
+
+    for (uint32_t id = 0; id < trace->ids; id++) {
+        kfree(slots[id]);
+    }
+    free(slots);
+    free(sizes);
+    return trace->count ? (double)elapsed / (double)trace->count : 0.0;
+}
+
+// Run a trace several times and keep the fastest
+static void run_trace(const Trace* trace, int runs) {
+    TraceResult result;
+
+    double best = replay(trace, &result, false);
+    for (int i = 1; i < runs; i++) {
+        double ns = replay(trace, &result, false);
+        if (ns < best) best = ns;
+    }
+    replay(trace, &result, true);
+    result.ns_per_op = best;
+
+    double footprint = (double)result.peak_frames * PAGE_SIZE;
+    printf("%-12s %9zu %8.1f %10.1f %10.1f %6.2fx %7zu %5u%% %5u%% %6zu %5zu\n",
+           trace->name, trace->count, result.ns_per_op,
+           result.peak_live / 1024.0, footprint / 1024.0,
+           result.peak_live ? footprint / (double)result.peak_live : 0.0,
+           result.faults, result.peak_fragmentation, result.end_fragmentation,
+           result.end_free_runs, result.failures);
+}
+
+int main(int argc, char** argv) {
+    int runs = 3;
+    int first = 1;
+
+    if (argc > 2 && strcmp(argv[1], "-r") == 0) {
+        runs = atoi(argv[2]);
+        if (runs < 1) runs = 1;
+        first = 3;
+    }
+
+    printf("%-12s %9s %8s %10s %10s %7s %7s %6s %6s %6s %5s\n",
+           "trace", "ops", "ns/op", "live KB", "frames KB", "ratio",
+           "faults", "frag", "end", "runs", "fail");
+
+    if (first >= argc) {
+        void (*generators[])(Trace*) = { gen_mixed, gen_windows, gen_packets };
+        for (size_t i = 0; i < sizeof(generators) / sizeof(generators[0]); i++) {
+            Trace trace = { 0 };
+            generators[i](&trace);
+            run_trace(&trace, runs);
+            free(trace.ops);
+        }
+        return 0;
+    }
+
+    int status = 0;
+    for (int i = first; i < argc; i++) {
+        Trace trace = { 0 };
+        if (load_trace(&trace, argv[i])) {
+            run_trace(&trace, runs);
+        } else {
+            status = 1;
+        }
+        free(trace.ops);
+    }
+    return status;
+}
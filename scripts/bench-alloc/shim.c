@@ -0,0 +1,121 @@
+// Userspace stand-ins for the page allocator and the VMM, so that
+// kernel/memory.c can be built unchanged for the host.
+//
+// The heap's virtual range is reserved PROT_NONE where memory_init asks
+// for it. vmm_map makes a page accessible, vmm_unmap throws its contents
+// away, and touches of reserved but unmapped pages arrive as SIGSEGV and
+// are handed to the handler registered with vmm_reserve, just like #PF
+// in the kernel.
+#define _GNU_SOURCE
+#include "shim.h"
+#include "pmm.h"
+#include "vmm.h"
+#include "cpu.h"
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#define SHIM_PAGE 4096
+
+static uintptr_t region_start = 0;
+static size_t region_size = 0;
+static VmmFaultHandler region_handler = NULL;
+
+static size_t frames_live = 0;
+static size_t frames_peak = 0;
+static uintptr_t next_frame = 0x100000;
+static size_t fault_count = 0;
+
+// Route faults inside the reserved range to its handler
+static void fault_signal(int sig, siginfo_t* info, void* context) {
+    (void)sig;
+    (void)context;
+    uintptr_t addr = (uintptr_t)info->si_addr;
+
+    if (region_handler && addr >= region_start && addr < region_start + region_size) {
+        fault_count++;
+        if (region_handler(addr)) return;
+    }
+
+    static const char msg[] = "bench-alloc: unresolved fault in the heap\n";
+    if (write(2, msg, sizeof(msg) - 1) < 0) {
+        // Nothing left to report to
+    }
+    _exit(2);
+}
+
+size_t shim_frames_live(void) { return frames_live; }
+size_t shim_frames_peak(void) { return frames_peak; }
+size_t shim_faults(void) { return fault_count; }
+
+// Frames are only counted; the addresses are never dereferenced
+uintptr_t alloc_pages(unsigned int order) {
+    size_t count = (size_t)1 << order;
+    uintptr_t frame = next_frame;
+    next_frame += count * SHIM_PAGE;
+    frames_live += count;
+    if (frames_live > frames_peak) {
+        frames_peak = frames_live;
+    }
+    return frame;
+}
+
+void free_pages(uintptr_t addr, unsigned int order) {
+    (void)addr;
+    frames_live -= (size_t)1 << order;
+}
+
+bool vmm_map(uintptr_t virt, uintptr_t phys, uint32_t flags) {
+    (void)phys;
+    (void)flags;
+    return mprotect((void*)(virt & ~(uintptr_t)(SHIM_PAGE - 1)), SHIM_PAGE,
+                    PROT_READ | PROT_WRITE) == 0;
+}
+
+uintptr_t vmm_unmap(uintptr_t virt) {
+    // A fresh PROT_NONE mapping releases the old contents
+    void* page = (void*)(virt & ~(uintptr_t)(SHIM_PAGE - 1));
+    mmap(page, SHIM_PAGE, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED, -1, 0);
+    return next_frame;
+}
+
+// memory_init reserves the heap range on every call. The first call
+// claims the address space; later ones drop whatever the previous run
+// left mapped, so each run starts from an empty heap.
+bool vmm_reserve(uintptr_t virt, size_t size, uint32_t flags, VmmFaultHandler handler) {
+    (void)flags;
+    int fixed = region_size ? MAP_FIXED : MAP_FIXED_NOREPLACE;
+    void* base = mmap((void*)virt, size, PROT_NONE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | fixed, -1, 0);
+    if (base != (void*)virt) {
+        fprintf(stderr, "bench-alloc: cannot reserve %#lx bytes at %#lx\n",
+                (unsigned long)size, (unsigned long)virt);
+        exit(1);
+    }
+
+    if (!region_size) {
+        struct sigaction action;
+        memset(&action, 0, sizeof(action));
+        action.sa_sigaction = fault_signal;
+        action.sa_flags = SA_SIGINFO;
+        sigemptyset(&action.sa_mask);
+        sigaction(SIGSEGV, &action, NULL);
+        sigaction(SIGBUS, &action, NULL);
+    }
+
+    region_start = virt;
+    region_size = size;
+    region_handler = handler;
+    frames_live = 0;
+    frames_peak = 0;
+    fault_count = 0;
+    return true;
+}
+
+void tlb_flush_range(uintptr_t virt, size_t pages) {
+    (void)virt;
+    (void)pages;
+}
@@ -0,0 +1,14 @@
+#ifndef SHIM_H
+#define SHIM_H
+
+#include <stddef.h>
+
+// Frames handed to the heap right now, and the most at any one time
+// since the last memory_init
+size_t shim_frames_live(void);
+size_t shim_frames_peak(void);
+
+// Heap page faults resolved since the last memory_init
+size_t shim_faults(void);
+
+#endif // SHIM_H
@@ -0,0 +1,23 @@
+// Force-included when building libk sources for the host, so that they
+// can be linked next to glibc and compared with it
+#define memset libk_memset
+#define memcpy libk_memcpy
+#define memmove libk_memmove
+#define memcmp libk_memcmp
+#define memset32 libk_memset32
+#define strcpy libk_strcpy
+#define strncpy libk_strncpy
+#define strcat libk_strcat
+#define strncat libk_strncat
+#define strcmp libk_strcmp
+#define strncmp libk_strncmp
+#define strlen libk_strlen
+#define strchr libk_strchr
+#define strrchr libk_strrchr
+#define strstr libk_strstr
+#define string_init libk_string_init
+#define atoi libk_atoi
+#define atol libk_atol
+#define atoll libk_atoll
+#define rand libk_rand
+#define srand libk_srand
@@ -0,0 +1,30 @@
+// Host stand-ins for the CPU and FPU hooks libk calls. Userspace may use
+// SSE freely, so FPU sections are always available and cost nothing.
+#include "cpu.h"
+#include "fpu.h"
+#include <cpuid.h>
+
+bool cpu_has_feature(uint32_t feature) {
+    if (feature == CPU_FEATURE_SSE2) return __builtin_cpu_supports("sse2");
+    return false;
+}
+
+bool cpu_has_extended_feature(uint32_t feature) {
+    unsigned int eax, ebx, ecx, edx;
+    if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) return false;
+    return (ebx & feature) != 0;
+}
+
+bool fpu_sse_enabled(void) {
+    return __builtin_cpu_supports("sse2");
+}
+
+bool kernel_fpu_usable(void) {
+    return true;
+}
+
+void kernel_fpu_begin(void) {
+}
+
+void kernel_fpu_end(void) {
+}
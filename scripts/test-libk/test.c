@@ -0,0 +1,354 @@
+// Host tests for libk. Every routine is fuzzed against glibc on random
+// inputs at all alignments, with buffers ending right before an unmapped
+// page so that any over-read faults. The memory routines are checked
+// once with the boot-time defaults and once after string_init has picked
+// the variants for this CPU. The kernel allocator is checked for sizes
+// that would wrap. A throughput table next to glibc follows.
+#define _GNU_SOURCE
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+void* libk_memset(void* dest, int val, size_t count);
+void* libk_memcpy(void* dest, const void* src, size_t count);
+void* libk_memmove(void* dest, const void* src, size_t count);
+int libk_memcmp(const void* ptr1, const void* ptr2, size_t count);
+void libk_memset32(uint32_t* dest, uint32_t value, size_t count);
+char* libk_strcpy(char* dest, const char* src);
+char* libk_strncpy(char* dest, const char* src, size_t count);
+char* libk_strcat(char* dest, const char* src);
+char* libk_strncat(char* dest, const char* src, size_t count);
+int libk_strcmp(const char* str1, const char* str2);
+int libk_strncmp(const char* str1, const char* str2, size_t count);
+size_t libk_strlen(const char* str);
+char* libk_strchr(const char* str, int ch);
+char* libk_strrchr(const char* str, int ch);
+char* libk_strstr(const char* str1, const char* str2);
+int libk_atoi(const char* str);
+long libk_atol(const char* str);
+long long libk_atoll(const char* str);
+void libk_string_init(void);
+
+void memory_init(void);
+void* kmalloc(size_t size);
+void* kcalloc(size_t count, size_t size);
+void* krealloc(void* ptr, size_t size);
+size_t ksize(const void* ptr);
+void kfree(void* ptr);
+
+#define FUZZ_ROUNDS 20000
+#define STR_MAX 300
+#define MEM_MAX 4096
+#define BIG_MAX (600 * 1024)    // Past the non-temporal threshold
+
+static size_t page_size;
+static int failures = 0;
+
+// Buffer whose last byte sits right before a PROT_NONE page
+static char* guarded(size_t size) {
+    size_t pages = (size + page_size - 1) / page_size + 1;
+    char* base = mmap(NULL, pages * page_size, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED) {
+        perror("mmap");
+        exit(1);
+    }
+    mprotect(base + (pages - 1) * page_size, page_size, PROT_NONE);
+    return base + (pages - 1) * page_size - size;
+}
+
+static int sign(long long value) {
+    return (value > 0) - (value < 0);
+}
+
+static void fail(const char* name, size_t round, size_t len) {
+    if (failures++ < 20) {
+        fprintf(stderr, "FAIL %s: round %zu, length %zu\n", name, round, len);
+    }
+}
+
+static void random_bytes(char* buf, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        buf[i] = (char)rand();
+    }
+}
+
+// Random non-zero bytes, high bit included, then a terminator. A small
+// alphabet makes matches and common prefixes likely.
+static void random_string(char* str, size_t len, int alphabet) {
+    for (size_t i = 0; i < len; i++) {
+        str[i] = (char)(alphabet ? 'a' + rand() % alphabet : rand() % 255 + 1);
+    }
+    str[len] = '\0';
+}
+
+// A string of random length ending exactly at the end of buf
+static char* string_at_end(char* buf, size_t size, int alphabet) {
+    size_t len = rand() % (size - 1);
+    char* str = buf + size - len - 1;
+    random_string(str, len, alphabet);
+    return str;
+}
+
+static void test_memory(size_t rounds) {
+    static char *a, *b, *ref;
+    if (!a) {
+        a = guarded(BIG_MAX);
+        b = guarded(BIG_MAX);
+        ref = malloc(BIG_MAX);
+    }
+
+    for (size_t round = 0; round < rounds; round++) {
+        size_t max = round % 100 == 0 ? BIG_MAX : MEM_MAX;
+        size_t len = rand() % (max - 64);
+        size_t da = rand() % 64, sa = rand() % 64;
+
+        random_bytes(a, max);
+        random_bytes(b, max);
+        memcpy(ref, b, max);
+
+        // memcpy
+        libk_memcpy(b + da, a + sa, len);
+        memcpy(ref + da, a + sa, len);
+        if (memcmp(b, ref, max)) fail("memcpy", round, len);
+
+        // memset
+        int val = rand();
+        libk_memset(b + sa, val, len);
+        memset(ref + sa, val, len);
+        if (memcmp(b, ref, max)) fail("memset", round, len);
+
+        // memmove, overlapping both ways
+        libk_memmove(b + da, b + sa, len);
+        memmove(ref + da, ref + sa, len);
+        if (memcmp(b, ref, max)) fail("memmove", round, len);
+
+        // memset32
+        uint32_t word = (uint32_t)rand() * 2654435761u;
+        size_t words = len / 4;
+        libk_memset32((uint32_t*)(b + (da & ~3)), word, words);
+        for (size_t i = 0; i < words; i++) {
+            memcpy(ref + (da & ~3) + 4 * i, &word, 4);
+        }
+        if (memcmp(b, ref, max)) fail("memset32", round, len);
+
+        // memcmp, equal or with one flipped bit, up to the guard page
+        size_t clen = rand() % MEM_MAX;
+        char* p1 = a + max - clen;
+        char* p2 = b + max - clen;
+        memcpy(p2, p1, clen);
+        if (clen && round % 3) p2[rand() % clen] ^= (char)(1 << rand() % 8);
+        if (sign(libk_memcmp(p1, p2, clen)) != sign(memcmp(p1, p2, clen))) {
+            fail("memcmp", round, clen);
+        }
+    }
+}
+
+static void test_strings(void) {
+    char* a = guarded(STR_MAX);
+    char* b = guarded(STR_MAX);
+    char* dest = malloc(4 * STR_MAX);
+    char* ref = malloc(4 * STR_MAX);
+
+    for (size_t round = 0; round < FUZZ_ROUNDS; round++) {
+        int alphabet = round % 4 == 0 ? 0 : (int)(round % 4) + 1;
+        char* s1 = string_at_end(a, STR_MAX, alphabet);
+        size_t len = strlen(s1);
+
+        if (libk_strlen(s1) != len) fail("strlen", round, len);
+
+        int ch = round % 5 == 0 ? 0 : len && round % 5 == 1 ? (unsigned char)s1[rand() % len]
+                                                              : rand() % 256;
+        if (libk_strchr(s1, ch) != strchr(s1, ch)) fail("strchr", round, len);
+        if (libk_strrchr(s1, ch) != strrchr(s1, ch)) fail("strrchr", round, len);
+
+        // Second string: a copy at another alignment, maybe changed or cut
+        char* s2 = b + STR_MAX - len - 1 - (round & 1 ? 0 : rand() % (STR_MAX - len));
+        memcpy(s2, s1, len + 1);
+        if (len && round % 3 == 1) s2[rand() % len] = (char)(rand() % 255 + 1);
+        if (len && round % 3 == 2) s2[rand() % len] = '\0';
+
+        if (sign(libk_strcmp(s1, s2)) != sign(strcmp(s1, s2)) ||
+            sign(libk_strcmp(s2, s1)) != sign(strcmp(s2, s1))) {
+            fail("strcmp", round, len);
+        }
+        size_t n = rand() % (len + 8);
+        if (sign(libk_strncmp(s1, s2, n)) != sign(strncmp(s1, s2, n))) {
+            fail("strncmp", round, n);
+        }
+
+        // strstr with a needle taken from the haystack or made up
+        char needle[16];
+        size_t nlen = rand() % 6;
+        if (len > nlen && round & 1) {
+            memcpy(needle, s1 + rand() % (len - nlen), nlen);
+            needle[nlen] = '\0';
+        } else {
+            random_string(needle, nlen, alphabet);
+        }
+        if (libk_strstr(s1, needle) != strstr(s1, needle)) fail("strstr", round, len);
+
+        // Copies into a buffer with a known fill, so padding is checked
+        memset(dest, 0x5A, 4 * STR_MAX);
+        memset(ref, 0x5A, 4 * STR_MAX);
+        if (libk_strcpy(dest, s1) != dest) fail("strcpy", round, len);
+        strcpy(ref, s1);
+        if (memcmp(dest, ref, 4 * STR_MAX)) fail("strcpy", round, len);
+
+        libk_strncpy(dest, s2, n);
+        strncpy(ref, s2, n);
+        if (memcmp(dest, ref, 4 * STR_MAX)) fail("strncpy", round, n);
+
+        libk_strcpy(dest, s1);
+        strcpy(ref, s1);
+        libk_strcat(dest, s2);
+        strcat(ref, s2);
+        if (memcmp(dest, ref, 4 * STR_MAX)) fail("strcat", round, len);
+
+        libk_strncat(dest, s1, n);
+        strncat(ref, s1, n);
+        if (memcmp(dest, ref, 4 * STR_MAX)) fail("strncat", round, n);
+    }
+
+    free(dest);
+    free(ref);
+}
+
+static void test_conversions(void) {
+    static const char* const prefixes[] = { "", " ", "\t\n ", "+", "-", " -", "x", "--1" };
+    char str[64];
+
+    for (size_t round = 0; round < FUZZ_ROUNDS; round++) {
+        // Values that fit the result type, and digits followed by junk
+        long long value = ((long long)rand() << 31 | rand()) >> (rand() % 63);
+        const char* prefix = prefixes[rand() % (sizeof(prefixes) / sizeof(prefixes[0]))];
+        snprintf(str, sizeof(str), "%s%lld%s", prefix, value < 0 ? -value : value,
+                 round & 1 ? "" : "z19");
+
+        if (libk_atoll(str) != atoll(str)) fail("atoll", round, strlen(str));
+        if ((value < 0 ? -value : value) <= 214748364) {
+            if (libk_atoi(str) != atoi(str)) fail("atoi", round, strlen(str));
+            if (libk_atol(str) != atol(str)) fail("atol", round, strlen(str));
+        }
+    }
+}
+
+// Sizes that wrap once the red zone or page rounding is added must be
+// refused, and a failed krealloc must leave the block as it was
+static void test_alloc_limits(void) {
+    static const size_t huge[] = { SIZE_MAX, SIZE_MAX - 7, SIZE_MAX - 4000, SIZE_MAX / 2 + 1 };
+    memory_init();
+
+    // Small enough to share a size class with a wrapped request
+    char* p = kmalloc(4);
+    if (!p) {
+        fail("kmalloc", 0, 4);
+        return;
+    }
+    memset(p, 0x5A, 4);
+
+    for (size_t i = 0; i < sizeof(huge) / sizeof(huge[0]); i++) {
+        if (kmalloc(huge[i])) fail("kmalloc huge", i, huge[i]);
+        if (kcalloc(1, huge[i])) fail("kcalloc huge", i, huge[i]);
+        if (krealloc(p, huge[i])) fail("krealloc huge", i, huge[i]);
+        if (ksize(p) < 4 || ksize(p) > 64) fail("krealloc ksize", i, ksize(p));
+        for (size_t j = 0; j < 4; j++) {
+            if (p[j] != 0x5A) {
+                fail("krealloc contents", i, j);
+                break;
+            }
+        }
+    }
+    kfree(p);
+}
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static volatile size_t sink;
+
+// glibc is called through pointers so the compiler cannot fold or
+// expand the calls
+static void* (*volatile glibc_memcpy)(void*, const void*, size_t) = memcpy;
+static void* (*volatile glibc_memset)(void*, int, size_t) = memset;
+static void* (*volatile glibc_memmove)(void*, const void*, size_t) = memmove;
+static int (*volatile glibc_memcmp)(const void*, const void*, size_t) = memcmp;
+static size_t (*volatile glibc_strlen)(const char*) = strlen;
+static char* (*volatile glibc_strchr)(const char*, int) = strchr;
+static int (*volatile glibc_strcmp)(const char*, const char*) = strcmp;
+static int (*volatile glibc_strncmp)(const char*, const char*, size_t) = strncmp;
+static char* (*volatile glibc_strcpy)(char*, const char*) = strcpy;
+
+// ns per call, after one warm-up call
+#define TIME(len, expr) ({                                      \
+    size_t reps = 4000000 / ((len) + 64) + 20;                  \
+    sink += (size_t)(expr);                                     \
+    double start = now();                                       \
+    for (size_t r = 0; r < reps; r++) sink += (size_t)(expr);   \
+    (now() - start) / reps;                                     \
+})
+
+static void row(const char* name, size_t len, double libk, double glibc) {
+    printf("%-8s %8zu %10.1f %10.1f %7.2fx %8.2f\n", name, len, libk, glibc,
+           libk / glibc, len / libk);
+}
+
+static void bench(void) {
+    static const size_t sizes[] = { 16, 256, 4096, 65536, 1 << 20 };
+    char* a = aligned_alloc(64, (1 << 20) + 64);
+    char* b = aligned_alloc(64, (1 << 20) + 64);
+
+    printf("\n%-8s %8s %10s %10s %8s %8s\n",
+           "routine", "bytes", "libk ns", "glibc ns", "ratio", "libk B/ns");
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        size_t len = sizes[i];
+        memset(a, 'x', len);
+        a[len] = '\0';
+        memcpy(b, a, len + 1);
+
+        row("memcpy", len, TIME(len, libk_memcpy(b, a, len)), TIME(len, glibc_memcpy(b, a, len)));
+        row("memset", len, TIME(len, libk_memset(b, 'x', len)), TIME(len, glibc_memset(b, 'x', len)));
+        row("memmove", len, TIME(len, libk_memmove(b + 1, b, len - 1)),
+            TIME(len, glibc_memmove(b + 1, b, len - 1)));
+        row("memcmp", len, TIME(len, libk_memcmp(a, b, len)), TIME(len, glibc_memcmp(a, b, len)));
+        if (len > 4096) continue;
+
+        row("strlen", len, TIME(len, libk_strlen(a)), TIME(len, glibc_strlen(a)));
+        row("strchr", len, TIME(len, libk_strchr(a, 'y')), TIME(len, glibc_strchr(a, 'y')));
+        row("strcmp", len, TIME(len, libk_strcmp(a, b)), TIME(len, glibc_strcmp(a, b)));
+        row("strncmp", len, TIME(len, libk_strncmp(a, b, len)), TIME(len, glibc_strncmp(a, b, len)));
+        row("strcpy", len, TIME(len, libk_strcpy(b, a)), TIME(len, glibc_strcpy(b, a)));
+    }
+
+    free(a);
+    free(b);
+}
+
+int main(void) {
+    page_size = (size_t)sysconf(_SC_PAGESIZE);
+    srand(1);
+
+    // Boot-time variants first, then whatever string_init picks
+    test_memory(FUZZ_ROUNDS / 4);
+    libk_string_init();
+    test_memory(FUZZ_ROUNDS);
+    test_strings();
+    test_conversions();
+    test_alloc_limits();
+
+    if (failures) {
+        printf("%d failures\n", failures);
+        return 1;
+    }
+    printf("libk: all tests passed\n");
+    bench();
+    return 0;
+}